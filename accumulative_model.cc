@@ -24,7 +24,8 @@ namespace learning_lda {
 
 LDAAccumulativeModel::LDAAccumulativeModel(int num_topics, int vocab_size) {
   CHECK_LT(1, num_topics);
-  CHECK_LT(1, vocab_size);
+  // A process of mpi_lda may own very few words.
+  CHECK_LE(0, vocab_size);
   global_distribution_.resize(num_topics, 0);
   zero_distribution_.resize(num_topics, 0);
   topic_distributions_.resize(vocab_size);
@@ -52,6 +53,25 @@ void LDAAccumulativeModel::AccumulateModel(const LDAModel& source_model) {
   }
 }
 
+void LDAAccumulativeModel::AccumulateWords(const LDAModel& source_model,
+                                           int first_word) {
+  CHECK_EQ(num_topics(), source_model.num_topics());
+  CHECK_LE(first_word + num_words(), source_model.num_words());
+  for (int i = 0; i < num_words(); ++i) {
+    const TopicCountDistribution& source_dist =
+        source_model.GetWordTopicDistribution(first_word + i);
+    TopicProbDistribution* dest_dist = &(topic_distributions_[i]);
+    for (int k = 0; k < num_topics(); ++k) {
+      (*dest_dist)[k] += static_cast<double>(source_dist[k]);
+    }
+  }
+
+  for (int k = 0; k < num_topics(); ++k) {
+    global_distribution_[k] +=
+        static_cast<double>(source_model.GetGlobalTopicDistribution()[k]);
+  }
+}
+
 void LDAAccumulativeModel::AverageModel(int num_accumulations) {
   for (vector<TopicProbDistribution>::iterator iter =
            topic_distributions_.begin();
@@ -84,8 +104,14 @@ void LDAAccumulativeModel::AppendAsString(const map<string, int>& word_index_map
        iter != word_index_map.end(); ++iter) {
     index_word_map[iter->second] = iter->first;
   }
+  AppendAsString(index_word_map, out);
+}
+
+void LDAAccumulativeModel::AppendAsString(const vector<string>& words,
+                                          std::ostream& out) const {
+  CHECK_EQ(num_words(), words.size());
   for (int i = 0; i < topic_distributions_.size(); ++i) {
-    out << index_word_map[i] << "\t";
+    out << words[i] << "\t";
     for (int topic = 0; topic < num_topics(); ++topic) {
       out << topic_distributions_[i][topic]
           << ((topic < num_topics() - 1) ? " " : "\n");
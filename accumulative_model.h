@@ -40,6 +40,11 @@ class LDAAccumulativeModel {
   // accumulative_global_distributions_.
   void AccumulateModel(const LDAModel& model);
 
+  // Accumulates the words [first_word, first_word + num_words()) of
+  // model, which may have more words, and its global distribution.
+  // Lets a process average only the words it owns.
+  void AccumulateWords(const LDAModel& model, int first_word);
+
   // Divide accumulative_topic_distributions_ and
   // accumulative_global_distributions_ by num_estiamte_iterations.
   void AverageModel(int num_estiamte_iterations);
@@ -61,6 +66,9 @@ class LDAAccumulativeModel {
   // format.
   void AppendAsString(const map<string, int>& word_index_map, std::ostream& out) const;
 
+  // The same, with words[i] the string of word i.
+  void AppendAsString(const vector<string>& words, std::ostream& out) const;
+
  private:
   // Increments the topic count for a particular word (or decrements, for
   // negative values of count).  Creates the word distribution if it doesn't
@@ -0,0 +1,83 @@
+// Copyright 2008 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "alias_sampler.h"
+
+namespace learning_lda {
+
+LDAAliasSampler::LDAAliasSampler(double alpha,
+                                 const LDAInferenceModel* model,
+                                 int mh_steps)
+    : alpha_(alpha), model_(model), mh_steps_(mh_steps) {
+  CHECK_LT(0.0, alpha);
+  CHECK(model != NULL);
+  CHECK_LT(0, mh_steps);
+}
+
+void LDAAliasSampler::SampleNewTopicsForDocument(LDADocument* document) const {
+  const int num_topics = model_->num_topics();
+  const vector<int64>& document_distribution = document->topic_distribution();
+  const DocumentWordTopicsPB& topics = document->topics();
+  const int document_length = topics.wordtopics_size();
+  const double document_proposal_mass = document_length + num_topics * alpha_;
+
+  for (LDADocument::WordOccurrenceIterator iterator(document);
+       !iterator.Done();
+       iterator.Next()) {
+    const int word = iterator.Word();
+    const int old_topic = iterator.Topic();
+    const float* word_topic_probs = model_->GetWordTopicProbabilities(word);
+    int topic = old_topic;
+    for (int step = 0; step < mh_steps_; ++step) {
+      // Word proposal: q(k) is proportional to P(w|z=k), which cancels
+      // out the word factor of the full conditional.
+      int proposal = model_->SampleTopicForWord(word);
+      if (proposal != topic) {
+        double acceptance =
+            (document_distribution[proposal] - (proposal == old_topic) +
+             alpha_) /
+            (document_distribution[topic] - (topic == old_topic) + alpha_);
+        if (RandDouble() < acceptance) {
+          topic = proposal;
+        }
+      }
+
+      // Document proposal: q(k) is proportional to n_dk + alpha, counting
+      // the current occurrence with its old topic.
+      double u = RandDouble() * document_proposal_mass;
+      if (u < document_length) {
+        proposal = topics.wordtopics(static_cast<int>(u));
+      } else {
+        proposal = RandInt(num_topics);
+      }
+      if (proposal != topic) {
+        double acceptance =
+            (document_distribution[proposal] - (proposal == old_topic) +
+             alpha_) * word_topic_probs[proposal] *
+            (document_distribution[topic] + alpha_) /
+            ((document_distribution[topic] - (topic == old_topic) +
+              alpha_) * word_topic_probs[topic] *
+             (document_distribution[proposal] + alpha_));
+        if (RandDouble() < acceptance) {
+          topic = proposal;
+        }
+      }
+    }
+    if (topic != old_topic) {
+      iterator.SetTopic(topic);
+    }
+  }
+}
+
+}  // namespace learning_lda
@@ -0,0 +1,54 @@
+// Copyright 2008 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef _OPENSOURCE_GLDA_ALIAS_SAMPLER_H__
+#define _OPENSOURCE_GLDA_ALIAS_SAMPLER_H__
+
+#include "common.h"
+#include "document.h"
+#include "inference_model.h"
+
+namespace learning_lda {
+
+// LDAAliasSampler samples the topics of query documents against a fixed
+// LDAInferenceModel by Metropolis-Hastings.  Instead of computing the
+// full conditional over all topics like LDASampler, every step
+// alternates between two proposals that can be drawn in constant time:
+//   - the word proposal P(w|z), drawn from the word's alias table, and
+//   - the document proposal n_dk + alpha, drawn by picking the topic of
+//     a random occurrence in the document, or a uniform topic.
+// and accepts the proposal with the Metropolis-Hastings ratio of the
+// full conditional (n_dk + alpha) * P(w|z=k).  So the cost per word
+// occurrence does not depend on the number of topics.
+class LDAAliasSampler {
+ public:
+  // mh_steps is the number of (word, document) proposal pairs per word
+  // occurrence.
+  LDAAliasSampler(double alpha, const LDAInferenceModel* model,
+                  int mh_steps);
+  ~LDAAliasSampler() {}
+
+  // Performs one round of sampling on a document.  Updates document's
+  // topic assignments; the model is never changed.
+  void SampleNewTopicsForDocument(LDADocument* document) const;
+
+ private:
+  const double alpha_;
+  const LDAInferenceModel* model_;
+  const int mh_steps_;
+};
+
+}  // namespace learning_lda
+
+#endif  // _OPENSOURCE_GLDA_ALIAS_SAMPLER_H__
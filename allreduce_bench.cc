@@ -0,0 +1,102 @@
+// Copyright 2008 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+/*
+  A microbenchmark of AllReduceTopicDistribution, which mpi_lda uses
+  to sum the models of all processes.  An example running of this
+  program:
+
+  mpiexec -n 4 ./allreduce_bench --max_model_mb 256
+
+  A model of 10 to 10000 topics and 1000 to 1000000 words, plus its
+  global topic distribution, is allreduced for at least 0.2 seconds of
+  the slowest process, skipping models whose counts take more than
+  max_model_mb megabytes.  The output has the format of lda_bench, with
+  the cell, i.e., one int64 count, as the unit.
+*/
+
+#include "mpi.h"
+
+#include <iostream>
+#include <vector>
+
+#include "common.h"
+#include "parallel_model.h"
+#include "cmd_flags.h"
+
+namespace learning_lda {
+
+const int kTopicSizes[] = { 10, 100, 1000, 10000 };
+const int kWordSizes[] = { 1000, 10000, 100000, 1000000 };
+const double kMinSeconds = 0.2;
+
+// Allreduces a num_topics x (num_words + 1) buffer and prints the line
+// on process 0.
+void RunAllReduceBenchmark(int num_topics, int num_words, int myid,
+                           int pnum) {
+  const int64 count = static_cast<int64>(num_topics) * (num_words + 1);
+  // Sums of zeros cost the same as any other sums, and never overflow.
+  vector<int64> buf(count, 0);
+  int64 units = 0;
+  MPI_Barrier(MPI_COMM_WORLD);
+  double start = WallTime();
+  double elapsed;
+  do {
+    AllReduceTopicDistribution(&buf[0], count);
+    units += count;
+    double local_elapsed = WallTime() - start;
+    MPI_Allreduce(&local_elapsed, &elapsed, 1, MPI_DOUBLE, MPI_MAX,
+                  MPI_COMM_WORLD);
+  } while (elapsed < kMinSeconds);
+  if (myid == 0) {
+    std::cout << "AllReduceTopicDistribution\t" << pnum << "\t"
+              << num_topics << "\t" << num_words << "\tcell\t"
+              << elapsed * 1e9 / units << "\t" << units / elapsed
+              << std::endl;
+  }
+}
+
+}  // namespace learning_lda
+
+int main(int argc, char** argv) {
+  using learning_lda::LDACmdLineFlags;
+  int myid, pnum;
+  MPI_Init(&argc, &argv);
+  MPI_Comm_rank(MPI_COMM_WORLD, &myid);
+  MPI_Comm_size(MPI_COMM_WORLD, &pnum);
+
+  LDACmdLineFlags flags;
+  flags.ParseCmdFlags(argc, argv);
+  if (!flags.CheckBenchmarkValidity()) {
+    MPI_Finalize();
+    return -1;
+  }
+  if (myid == 0) {
+    std::cout << "benchmark\tprocesses\tnum_topics\tnum_words\tunit\t"
+              << "ns_per_unit\tunits_per_second" << std::endl;
+  }
+  const int64 max_model_bytes = static_cast<int64>(flags.max_model_mb_) << 20;
+  for (int k = 0; k < sizeof(learning_lda::kTopicSizes) / sizeof(int); ++k) {
+    for (int v = 0; v < sizeof(learning_lda::kWordSizes) / sizeof(int); ++v) {
+      const int num_topics = learning_lda::kTopicSizes[k];
+      const int num_words = learning_lda::kWordSizes[v];
+      if (static_cast<int64>(num_topics) * (num_words + 1) * sizeof(int64) <=
+          max_model_bytes) {
+        learning_lda::RunAllReduceBenchmark(num_topics, num_words, myid,
+                                            pnum);
+      }
+    }
+  }
+  MPI_Finalize();
+  return 0;
+}
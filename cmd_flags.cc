@@ -14,6 +14,8 @@
 
 #include "cmd_flags.h"
 
+#include <unistd.h>
+
 #include <iostream>
 #include <sstream>
 
@@ -32,6 +34,47 @@ LDACmdLineFlags::LDACmdLineFlags() {
   burn_in_iterations_ = -1;
   total_iterations_ = -1;
   compute_likelihood_ = "false";
+  server_socket_ = "";
+  num_threads_ = 1;
+  pin_threads_ = "false";
+  model_placement_ = "first_touch";
+  huge_pages_ = "false";
+  batch_size_ = 1;
+  num_clients_ = 1;
+  num_requests_ = 0;
+  inference_method_ = "gibbs";
+  mh_steps_ = 2;
+  convergence_tolerance_ = 0;
+  output_iterations_ = "false";
+  quantized_model_file_ = "";
+  quantization_bits_ = 8;
+  sync_mode_ = "dense";
+  sync_chunks_ = 16;
+  sync_interval_ = 1;
+  sync_tokens_ = 0;
+  shared_model_ = "false";
+  out_of_core_file_ = "";
+  block_bytes_ = 64 << 20;
+  init_model_file_ = "";
+  target_loglikelihood_ = 0;
+  min_word_count_ = 0;
+  max_doc_frequency_ = 1;
+  max_vocab_size_ = 0;
+  num_hash_buckets_ = 0;
+  minibatch_size_ = 1024;
+  tau0_ = 1;
+  kappa_ = 0.6;
+  num_documents_ = 0;
+  num_words_ = 100000;
+  delta_density_ = 0.01;
+  max_model_mb_ = 256;
+  seed_ = 1;
+  training_mode_ = "data_parallel";
+  num_servers_ = 1;
+  staleness_ = 0;
+  partition_mode_ = "bytes";
+  num_partitions_ = 0;
+  partition_file_prefix_ = "";
 }
 
 void LDACmdLineFlags::ParseCmdFlags(int argc, char** argv) {
@@ -66,6 +109,129 @@ void LDACmdLineFlags::ParseCmdFlags(int argc, char** argv) {
     } else if (0 == strcmp(argv[i], "--compute_likelihood")) {
       compute_likelihood_ = argv[i+1];
       ++i;
+    } else if (0 == strcmp(argv[i], "--server_socket")) {
+      server_socket_ = argv[i+1];
+      ++i;
+    } else if (0 == strcmp(argv[i], "--num_threads")) {
+      std::istringstream(argv[i+1]) >> num_threads_;
+      ++i;
+    } else if (0 == strcmp(argv[i], "--pin_threads")) {
+      pin_threads_ = argv[i+1];
+      ++i;
+    } else if (0 == strcmp(argv[i], "--model_placement")) {
+      model_placement_ = argv[i+1];
+      ++i;
+    } else if (0 == strcmp(argv[i], "--huge_pages")) {
+      huge_pages_ = argv[i+1];
+      ++i;
+    } else if (0 == strcmp(argv[i], "--batch_size")) {
+      std::istringstream(argv[i+1]) >> batch_size_;
+      ++i;
+    } else if (0 == strcmp(argv[i], "--num_clients")) {
+      std::istringstream(argv[i+1]) >> num_clients_;
+      ++i;
+    } else if (0 == strcmp(argv[i], "--num_requests")) {
+      std::istringstream(argv[i+1]) >> num_requests_;
+      ++i;
+    } else if (0 == strcmp(argv[i], "--inference_method")) {
+      inference_method_ = argv[i+1];
+      ++i;
+    } else if (0 == strcmp(argv[i], "--mh_steps")) {
+      std::istringstream(argv[i+1]) >> mh_steps_;
+      ++i;
+    } else if (0 == strcmp(argv[i], "--convergence_tolerance")) {
+      std::istringstream(argv[i+1]) >> convergence_tolerance_;
+      ++i;
+    } else if (0 == strcmp(argv[i], "--output_iterations")) {
+      output_iterations_ = argv[i+1];
+      ++i;
+    } else if (0 == strcmp(argv[i], "--quantized_model_file")) {
+      quantized_model_file_ = argv[i+1];
+      ++i;
+    } else if (0 == strcmp(argv[i], "--quantization_bits")) {
+      std::istringstream(argv[i+1]) >> quantization_bits_;
+      ++i;
+    } else if (0 == strcmp(argv[i], "--sync_mode")) {
+      sync_mode_ = argv[i+1];
+      ++i;
+    } else if (0 == strcmp(argv[i], "--sync_chunks")) {
+      std::istringstream(argv[i+1]) >> sync_chunks_;
+      ++i;
+    } else if (0 == strcmp(argv[i], "--sync_interval")) {
+      std::istringstream(argv[i+1]) >> sync_interval_;
+      ++i;
+    } else if (0 == strcmp(argv[i], "--sync_tokens")) {
+      std::istringstream(argv[i+1]) >> sync_tokens_;
+      ++i;
+    } else if (0 == strcmp(argv[i], "--out_of_core_file")) {
+      out_of_core_file_ = argv[i+1];
+      ++i;
+    } else if (0 == strcmp(argv[i], "--block_bytes")) {
+      std::istringstream(argv[i+1]) >> block_bytes_;
+      ++i;
+    } else if (0 == strcmp(argv[i], "--init_model_file")) {
+      init_model_file_ = argv[i+1];
+      ++i;
+    } else if (0 == strcmp(argv[i], "--target_loglikelihood")) {
+      std::istringstream(argv[i+1]) >> target_loglikelihood_;
+      ++i;
+    } else if (0 == strcmp(argv[i], "--min_word_count")) {
+      std::istringstream(argv[i+1]) >> min_word_count_;
+      ++i;
+    } else if (0 == strcmp(argv[i], "--max_doc_frequency")) {
+      std::istringstream(argv[i+1]) >> max_doc_frequency_;
+      ++i;
+    } else if (0 == strcmp(argv[i], "--max_vocab_size")) {
+      std::istringstream(argv[i+1]) >> max_vocab_size_;
+      ++i;
+    } else if (0 == strcmp(argv[i], "--num_hash_buckets")) {
+      std::istringstream(argv[i+1]) >> num_hash_buckets_;
+      ++i;
+    } else if (0 == strcmp(argv[i], "--minibatch_size")) {
+      std::istringstream(argv[i+1]) >> minibatch_size_;
+      ++i;
+    } else if (0 == strcmp(argv[i], "--tau0")) {
+      std::istringstream(argv[i+1]) >> tau0_;
+      ++i;
+    } else if (0 == strcmp(argv[i], "--kappa")) {
+      std::istringstream(argv[i+1]) >> kappa_;
+      ++i;
+    } else if (0 == strcmp(argv[i], "--num_documents")) {
+      std::istringstream(argv[i+1]) >> num_documents_;
+      ++i;
+    } else if (0 == strcmp(argv[i], "--shared_model")) {
+      shared_model_ = argv[i+1];
+      ++i;
+    } else if (0 == strcmp(argv[i], "--num_words")) {
+      std::istringstream(argv[i+1]) >> num_words_;
+      ++i;
+    } else if (0 == strcmp(argv[i], "--delta_density")) {
+      std::istringstream(argv[i+1]) >> delta_density_;
+      ++i;
+    } else if (0 == strcmp(argv[i], "--max_model_mb")) {
+      std::istringstream(argv[i+1]) >> max_model_mb_;
+      ++i;
+    } else if (0 == strcmp(argv[i], "--seed")) {
+      std::istringstream(argv[i+1]) >> seed_;
+      ++i;
+    } else if (0 == strcmp(argv[i], "--training_mode")) {
+      training_mode_ = argv[i+1];
+      ++i;
+    } else if (0 == strcmp(argv[i], "--num_servers")) {
+      std::istringstream(argv[i+1]) >> num_servers_;
+      ++i;
+    } else if (0 == strcmp(argv[i], "--staleness")) {
+      std::istringstream(argv[i+1]) >> staleness_;
+      ++i;
+    } else if (0 == strcmp(argv[i], "--partition_mode")) {
+      partition_mode_ = argv[i+1];
+      ++i;
+    } else if (0 == strcmp(argv[i], "--num_partitions")) {
+      std::istringstream(argv[i+1]) >> num_partitions_;
+      ++i;
+    } else if (0 == strcmp(argv[i], "--partition_file_prefix")) {
+      partition_file_prefix_ = argv[i+1];
+      ++i;
     }
 
   }
@@ -101,6 +267,102 @@ bool LDACmdLineFlags::CheckTrainingValidity() {
     std::cerr << "total_iterations must > burn_in_iterations.\n";
     ret = false;
   }
+  if (block_bytes_ <= 0) {
+    std::cerr << "block_bytes must > 0.\n";
+    ret = false;
+  }
+  if (min_word_count_ < 0) {
+    std::cerr << "min_word_count must >= 0.\n";
+    ret = false;
+  }
+  if (max_doc_frequency_ <= 0 || max_doc_frequency_ > 1) {
+    std::cerr << "max_doc_frequency must be in (0, 1].\n";
+    ret = false;
+  }
+  if (max_vocab_size_ < 0) {
+    std::cerr << "max_vocab_size must >= 0.\n";
+    ret = false;
+  }
+  if (num_hash_buckets_ < 0) {
+    std::cerr << "num_hash_buckets must >= 0.\n";
+    ret = false;
+  }
+  if (!init_model_file_.empty() && !out_of_core_file_.empty()) {
+    std::cerr << "init_model_file cannot be used with out_of_core_file.\n";
+    ret = false;
+  }
+  // The file is removed when training ends.
+  if (!out_of_core_file_.empty() &&
+      access(out_of_core_file_.c_str(), F_OK) == 0) {
+    std::cerr << "out_of_core_file must not exist.\n";
+    ret = false;
+  }
+  return ret;
+}
+
+bool LDACmdLineFlags::CheckOnlineTrainingValidity() {
+  bool ret = true;
+  if (num_topics_ <= 1) {
+    std::cerr << "num_topics must >= 2.\n";
+    ret = false;
+  }
+  if (alpha_ <= 0) {
+    std::cerr << "alpha must > 0.\n";
+    ret = false;
+  }
+  if (beta_ <= 0) {
+    std::cerr << "beta must > 0.\n";
+    ret = false;
+  }
+  if (training_data_file_.empty()) {
+    std::cerr << "Invalid training_data_file.\n";
+    ret = false;
+  }
+  if (model_file_.empty()) {
+    std::cerr << "Invalid model_file.\n";
+    ret = false;
+  }
+  if (total_iterations_ <= 0) {
+    std::cerr << "total_iterations must > 0.\n";
+    ret = false;
+  }
+  if (minibatch_size_ <= 0) {
+    std::cerr << "minibatch_size must > 0.\n";
+    ret = false;
+  }
+  if (tau0_ < 1) {
+    std::cerr << "tau0 must >= 1.\n";
+    ret = false;
+  }
+  if (kappa_ <= 0.5 || kappa_ > 1) {
+    std::cerr << "kappa must be in (0.5, 1].\n";
+    ret = false;
+  }
+  if (num_documents_ < 0) {
+    std::cerr << "num_documents must >= 0.\n";
+    ret = false;
+  }
+  if (training_data_file_ == "-" &&
+      (min_word_count_ > 0 || max_doc_frequency_ < 1 || max_vocab_size_ > 0)) {
+    std::cerr << "The vocabulary of the standard input cannot be pruned.\n";
+    ret = false;
+  }
+  if (min_word_count_ < 0) {
+    std::cerr << "min_word_count must >= 0.\n";
+    ret = false;
+  }
+  if (max_doc_frequency_ <= 0 || max_doc_frequency_ > 1) {
+    std::cerr << "max_doc_frequency must be in (0, 1].\n";
+    ret = false;
+  }
+  if (max_vocab_size_ < 0) {
+    std::cerr << "max_vocab_size must >= 0.\n";
+    ret = false;
+  }
+  if (num_hash_buckets_ < 0) {
+    std::cerr << "num_hash_buckets must >= 0.\n";
+    ret = false;
+  }
   return ret;
 }
 
@@ -134,6 +396,163 @@ bool LDACmdLineFlags::CheckParallelTrainingValidity() {
     std::cerr << "compute_likelihood must be true or false.\n";
     ret = false;
   }
+  if (sync_mode_ != "dense" && sync_mode_ != "sparse" &&
+      sync_mode_ != "compressed" && sync_mode_ != "reduce_scatter" &&
+      sync_mode_ != "pipelined") {
+    std::cerr << "sync_mode must be dense, sparse, compressed, "
+              << "reduce_scatter or pipelined.\n";
+    ret = false;
+  }
+  if (sync_chunks_ <= 0) {
+    std::cerr << "sync_chunks must > 0.\n";
+    ret = false;
+  }
+  if (sync_interval_ <= 0) {
+    std::cerr << "sync_interval must > 0.\n";
+    ret = false;
+  }
+  if (min_word_count_ > 0 || max_doc_frequency_ < 1 ||
+      max_vocab_size_ > 0 || num_hash_buckets_ > 0) {
+    std::cerr << "min_word_count, max_doc_frequency, max_vocab_size and "
+              << "num_hash_buckets are not supported in parallel "
+              << "training.\n";
+    ret = false;
+  }
+  if (sync_tokens_ < 0) {
+    std::cerr << "sync_tokens must >= 0.\n";
+    ret = false;
+  }
+  if (sync_tokens_ > 0 && sync_interval_ > 1) {
+    std::cerr << "Only one of sync_interval and sync_tokens can be set.\n";
+    ret = false;
+  }
+  if ((sync_interval_ > 1 || sync_tokens_ > 0) &&
+      (training_mode_ != "data_parallel" || sync_mode_ == "pipelined")) {
+    std::cerr << "sync_interval and sync_tokens need data_parallel "
+              << "training_mode and a sync_mode other than pipelined.\n";
+    ret = false;
+  }
+  if (staleness_ > 0 && training_mode_ == "data_parallel" &&
+      sync_mode_ != "dense") {
+    std::cerr << "staleness > 0 needs dense sync_mode in data_parallel "
+              << "training_mode.\n";
+    ret = false;
+  }
+  if (burn_in_iterations_ >= 0 &&
+      (total_iterations_ <= burn_in_iterations_ ||
+       training_mode_ != "data_parallel")) {
+    std::cerr << "burn_in_iterations needs data_parallel training_mode and "
+              << "total_iterations > burn_in_iterations.\n";
+    ret = false;
+  }
+  if (shared_model_ != "true" && shared_model_ != "false") {
+    std::cerr << "shared_model must be true or false.\n";
+    ret = false;
+  }
+  if (shared_model_ == "true" &&
+      (training_mode_ != "data_parallel" || sync_mode_ != "dense" ||
+       staleness_ > 0)) {
+    std::cerr << "shared_model needs data_parallel training_mode, dense "
+              << "sync_mode and staleness 0.\n";
+    ret = false;
+  }
+  if (training_mode_ != "data_parallel" &&
+      training_mode_ != "model_parallel" &&
+      training_mode_ != "parameter_server") {
+    std::cerr << "training_mode must be data_parallel, model_parallel or "
+              << "parameter_server.\n";
+    ret = false;
+  }
+  if (num_servers_ <= 0) {
+    std::cerr << "num_servers must > 0.\n";
+    ret = false;
+  }
+  if (staleness_ < 0) {
+    std::cerr << "staleness must >= 0.\n";
+    ret = false;
+  }
+  if (partition_mode_ != "bytes" && partition_mode_ != "balanced" &&
+      partition_mode_ != "shards") {
+    std::cerr << "partition_mode must be bytes, balanced or shards.\n";
+    ret = false;
+  }
+  if (num_threads_ > 1 &&
+      (training_mode_ != "data_parallel" || sync_mode_ == "pipelined")) {
+    std::cerr << "num_threads > 1 needs data_parallel training_mode and "
+              << "a sync_mode other than pipelined.\n";
+    ret = false;
+  }
+  if (!CheckNumaValidity()) {
+    ret = false;
+  }
+  if ((pin_threads_ == "true" || model_placement_ != "first_touch") &&
+      (training_mode_ != "data_parallel" || sync_mode_ == "pipelined")) {
+    std::cerr << "pin_threads and model_placement need data_parallel "
+              << "training_mode and a sync_mode other than pipelined.\n";
+    ret = false;
+  }
+  if (model_placement_ == "replicate") {
+    std::cerr << "The model of training cannot be replicated, since all "
+              << "threads update it.\n";
+    ret = false;
+  }
+  if (model_placement_ == "interleave" && shared_model_ == "true") {
+    std::cerr << "model_placement interleave cannot be used with "
+              << "shared_model.\n";
+    ret = false;
+  }
+  return ret;
+}
+bool LDACmdLineFlags::CheckPartitioningValidity() {
+  bool ret = true;
+  if (training_data_file_.empty()) {
+    std::cerr << "Invalid training_data_file.\n";
+    ret = false;
+  }
+  if (num_partitions_ <= 0) {
+    std::cerr << "num_partitions must > 0.\n";
+    ret = false;
+  }
+  if (partition_file_prefix_.empty()) {
+    std::cerr << "Invalid partition_file_prefix.\n";
+    ret = false;
+  }
+  return ret;
+}
+bool LDACmdLineFlags::CheckSyncBenchmarkValidity() {
+  bool ret = true;
+  if (num_topics_ <= 1) {
+    std::cerr << "num_topics must >= 2.\n";
+    ret = false;
+  }
+  if (num_words_ <= 0) {
+    std::cerr << "num_words must > 0.\n";
+    ret = false;
+  }
+  if (delta_density_ <= 0 || delta_density_ > 1) {
+    std::cerr << "delta_density must be in (0, 1].\n";
+    ret = false;
+  }
+  if (total_iterations_ <= 0) {
+    std::cerr << "total_iterations must > 0.\n";
+    ret = false;
+  }
+  return ret;
+}
+bool LDACmdLineFlags::CheckBenchmarkValidity() {
+  bool ret = true;
+  if (max_model_mb_ <= 0) {
+    std::cerr << "max_model_mb must > 0.\n";
+    ret = false;
+  }
+  return ret;
+}
+bool LDACmdLineFlags::CheckParameterServerValidity() {
+  bool ret = CheckParallelTrainingValidity();
+  if (num_threads_ <= 0) {
+    std::cerr << "num_threads must > 0.\n";
+    ret = false;
+  }
   return ret;
 }
 bool LDACmdLineFlags::CheckInferringValidity() {
@@ -166,6 +585,135 @@ bool LDACmdLineFlags::CheckInferringValidity() {
     std::cerr << "total_iterations must > burn_in_iterations.\n";
     ret = false;
   }
+  if (output_iterations_ != "true" && output_iterations_ != "false") {
+    std::cerr << "output_iterations must be true or false.\n";
+    ret = false;
+  }
+  if (!CheckInferenceMethodValidity()) {
+    ret = false;
+  }
+  return ret;
+}
+
+bool LDACmdLineFlags::CheckServingValidity() {
+  bool ret = true;
+  if (alpha_ <= 0) {
+    std::cerr << "alpha must > 0.\n";
+    ret = false;
+  }
+  if (beta_ <= 0) {
+    std::cerr << "beta must > 0.\n";
+    ret = false;
+  }
+  if (model_file_.empty()) {
+    std::cerr << "Invalid model_file.\n";
+    ret = false;
+  }
+  if (burn_in_iterations_ < 0) {
+    std::cerr << "burn_in_iterations must >= 0.\n";
+    ret = false;
+  }
+  if (total_iterations_ <= burn_in_iterations_) {
+    std::cerr << "total_iterations must > burn_in_iterations.\n";
+    ret = false;
+  }
+  if (num_threads_ <= 0) {
+    std::cerr << "num_threads must > 0.\n";
+    ret = false;
+  }
+  if (batch_size_ <= 0) {
+    std::cerr << "batch_size must > 0.\n";
+    ret = false;
+  }
+  if (!CheckInferenceMethodValidity()) {
+    ret = false;
+  }
+  if (!CheckNumaValidity()) {
+    ret = false;
+  }
+  if (model_placement_ == "replicate" && pin_threads_ != "true") {
+    std::cerr << "model_placement replicate needs pin_threads.\n";
+    ret = false;
+  }
+  return ret;
+}
+
+bool LDACmdLineFlags::CheckNumaValidity() {
+  bool ret = true;
+  if (pin_threads_ != "true" && pin_threads_ != "false") {
+    std::cerr << "pin_threads must be true or false.\n";
+    ret = false;
+  }
+  if (model_placement_ != "first_touch" && model_placement_ != "interleave" &&
+      model_placement_ != "replicate") {
+    std::cerr << "model_placement must be first_touch, interleave or "
+              << "replicate.\n";
+    ret = false;
+  }
+  if (huge_pages_ != "true" && huge_pages_ != "false") {
+    std::cerr << "huge_pages must be true or false.\n";
+    ret = false;
+  }
+  return ret;
+}
+
+bool LDACmdLineFlags::CheckClientValidity() {
+  bool ret = true;
+  if (server_socket_.empty()) {
+    std::cerr << "Invalid server_socket.\n";
+    ret = false;
+  }
+  if (inference_data_file_.empty()) {
+    std::cerr << "Invalid inference_data_file.\n";
+    ret = false;
+  }
+  if (num_clients_ <= 0) {
+    std::cerr << "num_clients must > 0.\n";
+    ret = false;
+  }
+  if (num_requests_ < 0) {
+    std::cerr << "num_requests must >= 0.\n";
+    ret = false;
+  }
+  return ret;
+}
+
+bool LDACmdLineFlags::CheckInferenceMethodValidity() {
+  bool ret = true;
+  if (inference_method_ != "gibbs" && inference_method_ != "alias" &&
+      inference_method_ != "em") {
+    std::cerr << "inference_method must be gibbs, alias or em.\n";
+    ret = false;
+  }
+  if (mh_steps_ <= 0) {
+    std::cerr << "mh_steps must > 0.\n";
+    ret = false;
+  }
+  if (convergence_tolerance_ < 0) {
+    std::cerr << "convergence_tolerance must >= 0.\n";
+    ret = false;
+  }
+  return ret;
+}
+
+bool LDACmdLineFlags::CheckQuantizingValidity() {
+  bool ret = true;
+  if (beta_ <= 0) {
+    std::cerr << "beta must > 0.\n";
+    ret = false;
+  }
+  if (model_file_.empty()) {
+    std::cerr << "Invalid model_file.\n";
+    ret = false;
+  }
+  if (quantized_model_file_.empty()) {
+    std::cerr << "Invalid quantized_model_file.\n";
+    ret = false;
+  }
+  if (quantization_bits_ != 8 && quantization_bits_ != 16) {
+    std::cerr << "quantization_bits must be 8 or 16.\n";
+    ret = false;
+  }
   return ret;
 }
 
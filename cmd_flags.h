@@ -25,8 +25,18 @@ class LDACmdLineFlags {
   LDACmdLineFlags();
   void ParseCmdFlags(int argc, char** argv);
   bool CheckTrainingValidity();
+  bool CheckOnlineTrainingValidity();
   bool CheckParallelTrainingValidity();
+  bool CheckParameterServerValidity();
+  bool CheckPartitioningValidity();
+  bool CheckSyncBenchmarkValidity();
+  bool CheckBenchmarkValidity();
   bool CheckInferringValidity();
+  bool CheckServingValidity();
+  bool CheckClientValidity();
+  bool CheckInferenceMethodValidity();
+  bool CheckNumaValidity();
+  bool CheckQuantizingValidity();
 
   int         num_topics_;
   double      alpha_;
@@ -38,6 +48,47 @@ class LDACmdLineFlags {
   int         burn_in_iterations_;
   int         total_iterations_;
   std::string compute_likelihood_;
+  std::string server_socket_;
+  int         num_threads_;
+  std::string pin_threads_;
+  std::string model_placement_;
+  std::string huge_pages_;
+  int         batch_size_;
+  int         num_clients_;
+  int         num_requests_;
+  std::string inference_method_;
+  int         mh_steps_;
+  double      convergence_tolerance_;
+  std::string output_iterations_;
+  std::string quantized_model_file_;
+  int         quantization_bits_;
+  std::string sync_mode_;
+  int         sync_chunks_;
+  int         sync_interval_;
+  int         sync_tokens_;
+  std::string shared_model_;
+  std::string out_of_core_file_;
+  int         block_bytes_;
+  std::string init_model_file_;
+  double      target_loglikelihood_;
+  int         min_word_count_;
+  double      max_doc_frequency_;
+  int         max_vocab_size_;
+  int         num_hash_buckets_;
+  int         minibatch_size_;
+  double      tau0_;
+  double      kappa_;
+  int         num_documents_;
+  int         num_words_;
+  double      delta_density_;
+  int         max_model_mb_;
+  int         seed_;
+  std::string training_mode_;
+  int         num_servers_;
+  int         staleness_;
+  std::string partition_mode_;
+  int         num_partitions_;
+  std::string partition_file_prefix_;
 };
 
 }  // namespace learning_lda
@@ -14,10 +14,30 @@
 
 #include "common.h"
 
+#include <sys/time.h>
+
 char kSegmentFaultCauser[] = "Used to cause artificial segmentation fault";
 
 namespace learning_lda {
 
+namespace {
+
+__thread bool random_state_seeded = false;
+__thread unsigned short random_state[3];
+
+}  // namespace
+
+double RandDouble() {
+  if (!random_state_seeded) {
+    int seed = rand();
+    random_state[0] = 0x330E;
+    random_state[1] = seed & 0xFFFF;
+    random_state[2] = seed >> 16;
+    random_state_seeded = true;
+  }
+  return erand48(random_state);
+}
+
 bool IsValidProbDistribution(const TopicProbDistribution& dist) {
   const double kUnificationError = 0.00001;
   double sum_distribution = 0;
@@ -49,6 +69,21 @@ int GetAccumulativeSample(const vector<double>& distribution) {
   return -1;
 }
 
+double WallTime() {
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+unsigned int HashWord(const string& word) {
+  unsigned int hash = 2166136261u;
+  for (int i = 0; i < word.size(); ++i) {
+    hash ^= static_cast<unsigned char>(word[i]);
+    hash *= 16777619u;
+  }
+  return hash;
+}
+
 std::ostream& operator << (std::ostream& out, vector<double>& v) {
   for (size_t i = 0; i < v.size(); ++i) {
     out << v[i] << " ";
@@ -187,6 +187,7 @@ struct DocumentWordTopicsPB {
     return wordtopics_start_index_[word_index + 1] - 1;
   }
   int word(int word_index) const { return words_[word_index]; }
+  int wordtopics_size() const { return wordtopics_.size(); }
   int32 wordtopics(int index) const { return wordtopics_[index]; }
   int32* mutable_wordtopics(int index) { return &wordtopics_[index]; }
 
@@ -205,10 +206,10 @@ struct DocumentWordTopicsPB {
 };
 
 // Generate a random float value in the range of [0,1) from the
-// uniform distribution.
-inline double RandDouble() {
-  return rand() / (static_cast<double>(RAND_MAX) + 0.000001);
-}
+// uniform distribution.  Every thread has its own generator, seeded by
+// rand() when the thread first draws, so that sampling threads do not
+// contend for the lock of rand().
+double RandDouble();
 
 // Generate a random integer value in the range of [0,bound) from the
 // uniform distribution.
@@ -221,6 +222,14 @@ inline int RandInt(int bound) {
 // Returns a sample selected from a non-normalized probability distribution.
 int GetAccumulativeSample(const vector<double>& distribution);
 
+// Returns the wall clock time in seconds, used to time iterations and
+// requests.
+double WallTime();
+
+// Returns the FNV-1a hash of word, which does not depend on the process
+// or the run.
+unsigned int HashWord(const string& word);
+
 
 // Steaming output facilities.
 std::ostream& operator << (std::ostream& out, vector<double>& v);
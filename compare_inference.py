@@ -0,0 +1,38 @@
+#!/usr/bin/python
+# Compare two inference results of the same documents, e.g. of two
+# inference methods of infer.
+# ./compare_inference.py inference_result_1 inference_result_2
+
+import sys
+
+def normalize(line):
+  # Diagnostic columns, e.g. the number of iterations, follow a tab.
+  values = [float(x) for x in line.split("\t")[0].split()]
+  total = sum(values)
+  if total <= 0:
+    return [1.0 / len(values)] * len(values)
+  return [x / total for x in values]
+
+def argmax(v):
+  return max(range(len(v)), key=lambda i: v[i])
+
+num_documents = 0
+total_l1 = 0.0
+max_l1 = 0.0
+top_topic_agreements = 0
+for line1, line2 in zip(open(sys.argv[1]), open(sys.argv[2])):
+  p = normalize(line1)
+  q = normalize(line2)
+  l1 = sum(abs(x - y) for x, y in zip(p, q))
+  total_l1 += l1
+  max_l1 = max(max_l1, l1)
+  if argmax(p) == argmax(q):
+    top_topic_agreements += 1
+  num_documents += 1
+
+if num_documents == 0:
+  sys.exit("No documents to compare.")
+print("documents: %d" % num_documents)
+print("mean_l1_distance: %f" % (total_l1 / num_documents))
+print("max_l1_distance: %f" % max_l1)
+print("top_topic_agreement: %f" % (float(top_topic_agreements) / num_documents))
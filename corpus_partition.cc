@@ -0,0 +1,79 @@
+// Copyright 2008 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "corpus_partition.h"
+
+#include <algorithm>
+#include <functional>
+#include <queue>
+#include <sstream>
+#include <utility>
+
+namespace learning_lda {
+
+int64 CountDocumentTokens(const string& line) {
+  std::istringstream ss(line);
+  string word;
+  int count;
+  int64 tokens = 0;
+  while (ss >> word >> count) {
+    tokens += count;
+  }
+  return tokens;
+}
+
+int PrefixSumPartition(int64 tokens_before, int64 tokens, int64 total_tokens,
+                       int num_partitions) {
+  if (total_tokens <= 0) {
+    return 0;
+  }
+  // Doubled to stay in integers.
+  int64 middle = 2 * tokens_before + tokens;
+  int partition = middle * num_partitions / (2 * total_tokens);
+  return std::min(partition, num_partitions - 1);
+}
+
+void LongestProcessingTimePartition(const vector<int64>& tokens,
+                                    int num_partitions,
+                                    vector<int>* partitions) {
+  vector<std::pair<int64, int> > documents(tokens.size());
+  for (int i = 0; i < tokens.size(); ++i) {
+    documents[i] = std::make_pair(tokens[i], i);
+  }
+  std::sort(documents.begin(), documents.end(),
+            std::greater<std::pair<int64, int> >());
+  // The least loaded partition is on top.
+  std::priority_queue<std::pair<int64, int>,
+                      vector<std::pair<int64, int> >,
+                      std::greater<std::pair<int64, int> > > loads;
+  for (int p = 0; p < num_partitions; ++p) {
+    loads.push(std::make_pair(0, p));
+  }
+  partitions->resize(tokens.size());
+  for (int i = 0; i < documents.size(); ++i) {
+    std::pair<int64, int> load = loads.top();
+    loads.pop();
+    (*partitions)[documents[i].second] = load.second;
+    load.first += documents[i].first;
+    loads.push(load);
+  }
+}
+
+string PartitionFileName(const string& prefix, int part, int num_partitions) {
+  std::ostringstream name;
+  name << prefix << "-" << part << "-of-" << num_partitions;
+  return name.str();
+}
+
+}  // namespace learning_lda
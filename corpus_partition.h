@@ -0,0 +1,51 @@
+// Copyright 2008 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef _OPENSOURCE_GLDA_CORPUS_PARTITION_H__
+#define _OPENSOURCE_GLDA_CORPUS_PARTITION_H__
+
+#include <string>
+#include <vector>
+
+#include "common.h"
+
+namespace learning_lda {
+
+// Returns the number of word occurrences of a document line in the
+// training data format.
+int64 CountDocumentTokens(const string& line);
+
+// Returns the partition of a document in a contiguous split of a corpus
+// into num_partitions partitions of about the same number of tokens.
+// The document has tokens tokens, tokens_before tokens precede it and
+// the corpus has total_tokens tokens.  A document goes to the partition
+// holding its middle token.
+int PrefixSumPartition(int64 tokens_before, int64 tokens, int64 total_tokens,
+                       int num_partitions);
+
+// Assigns documents with the given token counts to num_partitions
+// partitions by the greedy longest-processing-time rule: the longest
+// document not yet assigned goes to the partition with the fewest
+// tokens.  Fills partitions with the partition of every document.
+void LongestProcessingTimePartition(const vector<int64>& tokens,
+                                    int num_partitions,
+                                    vector<int>* partitions);
+
+// Returns the file name of partition part of num_partitions of a corpus,
+// i.e., <prefix>-<part>-of-<num_partitions>.
+string PartitionFileName(const string& prefix, int part, int num_partitions);
+
+}  // namespace learning_lda
+
+#endif  // _OPENSOURCE_GLDA_CORPUS_PARTITION_H__
@@ -0,0 +1,248 @@
+// Copyright 2008 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "delta_codec.h"
+
+#ifdef USE_ZLIB
+#include <zlib.h>
+#endif
+
+namespace learning_lda {
+
+namespace {
+
+typedef unsigned long long uint64;
+
+// The first byte of an encoded delta.
+const char kUncompressed = 0;
+const char kZlibCompressed = 1;
+
+inline uint64 ZigZag(int64 value) {
+  return (static_cast<uint64>(value) << 1) ^ static_cast<uint64>(value >> 63);
+}
+
+inline int64 UnZigZag(uint64 value) {
+  return static_cast<int64>(value >> 1) ^ -static_cast<int64>(value & 1);
+}
+
+inline int VarintLength(uint64 value) {
+  int length = 1;
+  while (value >= 128) {
+    value >>= 7;
+    ++length;
+  }
+  return length;
+}
+
+inline void AppendVarint(uint64 value, std::string* out) {
+  while (value >= 128) {
+    out->push_back(static_cast<char>((value & 127) | 128));
+    value >>= 7;
+  }
+  out->push_back(static_cast<char>(value));
+}
+
+inline bool ReadVarint(const char** data, const char* end, uint64* value) {
+  *value = 0;
+  for (int shift = 0; shift < 64; shift += 7) {
+    if (*data == end) {
+      return false;
+    }
+    unsigned char byte = **data;
+    ++*data;
+    *value |= static_cast<uint64>(byte & 127) << shift;
+    if (byte < 128) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Decodes the records of an uncompressed delta.
+bool DecodeRows(const char* data, const char* end, LDAModelDelta* delta) {
+  const int num_topics = delta->num_topics();
+  int64 word = -1;
+  while (data < end) {
+    uint64 skip, value;
+    if (!ReadVarint(&data, end, &skip) || data == end) {
+      return false;
+    }
+    word += skip + 1;
+    char encoding = *data++;
+    if (encoding == kDenseRow) {
+      for (int k = 0; k < num_topics; ++k) {
+        if (!ReadVarint(&data, end, &value)) {
+          return false;
+        }
+        if (value != 0) {
+          delta->Add(word, k, UnZigZag(value));
+        }
+      }
+    } else if (encoding == kBitmapRow) {
+      const char* bitmap = data;
+      data += (num_topics + 7) / 8;
+      if (data > end) {
+        return false;
+      }
+      for (int k = 0; k < num_topics; ++k) {
+        if (bitmap[k / 8] & (1 << (k % 8))) {
+          if (!ReadVarint(&data, end, &value)) {
+            return false;
+          }
+          delta->Add(word, k, UnZigZag(value));
+        }
+      }
+    } else if (encoding == kRunLengthRow) {
+      uint64 num_nonzeros, zeros;
+      if (!ReadVarint(&data, end, &num_nonzeros)) {
+        return false;
+      }
+      int64 topic = -1;
+      for (uint64 i = 0; i < num_nonzeros; ++i) {
+        if (!ReadVarint(&data, end, &zeros) ||
+            !ReadVarint(&data, end, &value)) {
+          return false;
+        }
+        topic += zeros + 1;
+        if (topic >= num_topics) {
+          return false;
+        }
+        delta->Add(word, topic, UnZigZag(value));
+      }
+    } else {
+      return false;
+    }
+  }
+  return true;
+}
+
+}  // namespace
+
+void EncodeModelDelta(const LDAModelDelta& delta, std::string* out,
+                      vector<int64>* row_encodings) {
+  const int num_topics = delta.num_topics();
+  const vector<int64>& cells = delta.cells();
+  const vector<int32>& counts = delta.counts();
+  std::string rows;
+  int64 previous_word = -1;
+  for (int64 begin = 0; begin < cells.size(); ) {
+    const int64 word = cells[begin] / num_topics;
+    int64 end = begin;
+    int64 value_bytes = 0;
+    int64 gap_bytes = 0;
+    int64 previous_topic = -1;
+    while (end < cells.size() && cells[end] / num_topics == word) {
+      int64 topic = cells[end] % num_topics;
+      value_bytes += VarintLength(ZigZag(counts[end]));
+      gap_bytes += VarintLength(topic - previous_topic - 1);
+      previous_topic = topic;
+      ++end;
+    }
+    const int num_nonzeros = end - begin;
+    const int64 dense_bytes = num_topics - num_nonzeros + value_bytes;
+    const int64 bitmap_bytes = (num_topics + 7) / 8 + value_bytes;
+    const int64 run_length_bytes =
+        VarintLength(num_nonzeros) + gap_bytes + value_bytes;
+    RowEncoding encoding = kRunLengthRow;
+    if (dense_bytes <= bitmap_bytes && dense_bytes <= run_length_bytes) {
+      encoding = kDenseRow;
+    } else if (bitmap_bytes < run_length_bytes) {
+      encoding = kBitmapRow;
+    }
+    if (row_encodings != NULL) {
+      row_encodings->resize(kNumRowEncodings, 0);
+      ++(*row_encodings)[encoding];
+    }
+
+    AppendVarint(word - previous_word - 1, &rows);
+    rows.push_back(static_cast<char>(encoding));
+    if (encoding == kDenseRow) {
+      int64 i = begin;
+      for (int k = 0; k < num_topics; ++k) {
+        if (i < end && cells[i] % num_topics == k) {
+          AppendVarint(ZigZag(counts[i++]), &rows);
+        } else {
+          rows.push_back(0);
+        }
+      }
+    } else if (encoding == kBitmapRow) {
+      std::string::size_type bitmap = rows.size();
+      rows.append((num_topics + 7) / 8, 0);
+      for (int64 i = begin; i < end; ++i) {
+        int topic = cells[i] % num_topics;
+        rows[bitmap + topic / 8] |= 1 << (topic % 8);
+        AppendVarint(ZigZag(counts[i]), &rows);
+      }
+    } else {
+      AppendVarint(num_nonzeros, &rows);
+      previous_topic = -1;
+      for (int64 i = begin; i < end; ++i) {
+        int64 topic = cells[i] % num_topics;
+        AppendVarint(topic - previous_topic - 1, &rows);
+        AppendVarint(ZigZag(counts[i]), &rows);
+        previous_topic = topic;
+      }
+    }
+    previous_word = word;
+    begin = end;
+  }
+
+  out->clear();
+#ifdef USE_ZLIB
+  uLongf compressed_size = compressBound(rows.size());
+  std::string compressed(compressed_size, 0);
+  if (compress2(reinterpret_cast<Bytef*>(&compressed[0]), &compressed_size,
+                reinterpret_cast<const Bytef*>(rows.data()), rows.size(),
+                Z_BEST_SPEED) == Z_OK &&
+      compressed_size + VarintLength(rows.size()) < rows.size()) {
+    out->push_back(kZlibCompressed);
+    AppendVarint(rows.size(), out);
+    out->append(compressed, 0, compressed_size);
+    return;
+  }
+#endif
+  out->push_back(kUncompressed);
+  out->append(rows);
+}
+
+bool DecodeModelDelta(const char* data, int64 size, LDAModelDelta* delta) {
+  const char* end = data + size;
+  if (data == end) {
+    return false;
+  }
+  char format = *data++;
+  if (format == kUncompressed) {
+    return DecodeRows(data, end, delta);
+  }
+#ifdef USE_ZLIB
+  if (format == kZlibCompressed) {
+    uint64 rows_size;
+    if (!ReadVarint(&data, end, &rows_size)) {
+      return false;
+    }
+    std::string rows(rows_size, 0);
+    uLongf uncompressed_size = rows_size;
+    if (rows_size == 0 ||
+        uncompress(reinterpret_cast<Bytef*>(&rows[0]), &uncompressed_size,
+                   reinterpret_cast<const Bytef*>(data), end - data) != Z_OK ||
+        uncompressed_size != rows_size) {
+      return false;
+    }
+    return DecodeRows(rows.data(), rows.data() + rows.size(), delta);
+  }
+#endif
+  return false;
+}
+
+}  // namespace learning_lda
@@ -0,0 +1,55 @@
+// Copyright 2008 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef _OPENSOURCE_GLDA_DELTA_CODEC_H__
+#define _OPENSOURCE_GLDA_DELTA_CODEC_H__
+
+#include <string>
+
+#include "common.h"
+#include "model.h"
+
+namespace learning_lda {
+
+// The encodings of the changes of one word row of an LDAModelDelta.
+// Counts are zigzag varints, so that the small positive and negative
+// changes of a synchronization take one byte each.
+enum RowEncoding {
+  // All num_topics counts, zeros included.
+  kDenseRow = 0,
+  // A bitmap of the topics with nonzero counts, then those counts.
+  kBitmapRow = 1,
+  // The number of nonzero counts, then for each one the number of zero
+  // counts before it and the count.
+  kRunLengthRow = 2,
+  kNumRowEncodings = 3
+};
+
+// Encodes delta, which must be compacted (see LDAModelDelta::Compact),
+// into out.  Rows without changes take no space and every other row is
+// written in the encoding that is the shortest for its density.  If
+// built with USE_ZLIB, the result is further compressed by zlib when
+// that makes it shorter.  If row_encodings is not NULL, the number of
+// rows written in each encoding is added to it.
+void EncodeModelDelta(const LDAModelDelta& delta, std::string* out,
+                      vector<int64>* row_encodings);
+
+// Decodes the size bytes at data written by EncodeModelDelta of a delta
+// of delta->num_topics() topics and appends its changes to delta.
+// Returns false if the data is corrupt.
+bool DecodeModelDelta(const char* data, int64 size, LDAModelDelta* delta);
+
+}  // namespace learning_lda
+
+#endif  // _OPENSOURCE_GLDA_DELTA_CODEC_H__
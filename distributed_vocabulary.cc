@@ -0,0 +1,161 @@
+// Copyright 2008 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "distributed_vocabulary.h"
+
+#include <algorithm>
+
+namespace learning_lda {
+
+namespace {
+
+// Packs words as '\0' terminated strings.
+void PackWords(const vector<string>& words, vector<char>* buffer) {
+  for (int i = 0; i < words.size(); ++i) {
+    buffer->insert(buffer->end(), words[i].begin(), words[i].end());
+    buffer->push_back('\0');
+  }
+}
+
+// Returns the displacements of consecutive blocks of the given sizes.
+vector<int> Displacements(const vector<int>& sizes) {
+  vector<int> displacements(sizes.size(), 0);
+  for (int i = 1; i < sizes.size(); ++i) {
+    displacements[i] = displacements[i - 1] + sizes[i - 1];
+  }
+  return displacements;
+}
+
+// MPI does not accept a NULL buffer even for empty messages.
+template <typename T>
+T* Data(vector<T>* values) {
+  static T dummy;
+  return values->empty() ? &dummy : &(*values)[0];
+}
+
+}  // namespace
+
+DistributedVocabulary::DistributedVocabulary(
+    const std::set<string>& local_words) {
+  int pnum;
+  MPI_Comm_size(MPI_COMM_WORLD, &pnum);
+
+  // Sends every local word to its owner.
+  vector<vector<string> > words_by_owner(pnum);
+  for (std::set<string>::const_iterator iter = local_words.begin();
+       iter != local_words.end(); ++iter) {
+    words_by_owner[HashWord(*iter) % pnum].push_back(*iter);
+  }
+  vector<char> send_buffer;
+  vector<int> send_sizes(pnum);
+  for (int p = 0; p < pnum; ++p) {
+    int begin = send_buffer.size();
+    PackWords(words_by_owner[p], &send_buffer);
+    send_sizes[p] = send_buffer.size() - begin;
+  }
+  vector<int> receive_sizes(pnum);
+  MPI_Alltoall(&send_sizes[0], 1, MPI_INT, &receive_sizes[0], 1, MPI_INT,
+               MPI_COMM_WORLD);
+  vector<int> send_displacements = Displacements(send_sizes);
+  vector<int> receive_displacements = Displacements(receive_sizes);
+  vector<char> receive_buffer(receive_displacements[pnum - 1] +
+                              receive_sizes[pnum - 1]);
+  MPI_Alltoallv(Data(&send_buffer), &send_sizes[0], &send_displacements[0],
+                MPI_CHAR, Data(&receive_buffer), &receive_sizes[0],
+                &receive_displacements[0], MPI_CHAR, MPI_COMM_WORLD);
+
+  // Numbers the distinct words received.
+  vector<vector<string> > requests(pnum);
+  for (int p = 0; p < pnum; ++p) {
+    int end = receive_displacements[p] + receive_sizes[p];
+    for (int i = receive_displacements[p]; i < end;
+         i += strlen(&receive_buffer[i]) + 1) {
+      requests[p].push_back(&receive_buffer[i]);
+      owned_words_.push_back(requests[p].back());
+    }
+  }
+  std::sort(owned_words_.begin(), owned_words_.end());
+  owned_words_.erase(std::unique(owned_words_.begin(), owned_words_.end()),
+                     owned_words_.end());
+  int num_owned = owned_words_.size();
+  owned_begin_ = 0;
+  MPI_Exscan(&num_owned, &owned_begin_, 1, MPI_INT, MPI_SUM, MPI_COMM_WORLD);
+  int myid;
+  MPI_Comm_rank(MPI_COMM_WORLD, &myid);
+  if (myid == 0) {
+    // MPI_Exscan leaves the result on process 0 undefined.
+    owned_begin_ = 0;
+  }
+  MPI_Allreduce(&num_owned, &num_words_, 1, MPI_INT, MPI_SUM, MPI_COMM_WORLD);
+
+  // Sends the indices back in the order the words came in.
+  vector<int> reply;
+  vector<int> reply_sizes(pnum);
+  for (int p = 0; p < pnum; ++p) {
+    for (int i = 0; i < requests[p].size(); ++i) {
+      reply.push_back(owned_begin_ +
+                      std::lower_bound(owned_words_.begin(),
+                                       owned_words_.end(), requests[p][i]) -
+                      owned_words_.begin());
+    }
+    reply_sizes[p] = requests[p].size();
+  }
+  vector<int> index_sizes(pnum);
+  for (int p = 0; p < pnum; ++p) {
+    index_sizes[p] = words_by_owner[p].size();
+  }
+  vector<int> reply_displacements = Displacements(reply_sizes);
+  vector<int> index_displacements = Displacements(index_sizes);
+  vector<int> indices(local_words.size());
+  MPI_Alltoallv(Data(&reply), &reply_sizes[0], &reply_displacements[0],
+                MPI_INT, Data(&indices), &index_sizes[0],
+                &index_displacements[0], MPI_INT, MPI_COMM_WORLD);
+  for (int p = 0; p < pnum; ++p) {
+    for (int i = 0; i < words_by_owner[p].size(); ++i) {
+      word_index_map_[words_by_owner[p][i]] =
+          indices[index_displacements[p] + i];
+    }
+  }
+}
+
+void DistributedVocabulary::Gather(int root, vector<string>* words) const {
+  int myid, pnum;
+  MPI_Comm_rank(MPI_COMM_WORLD, &myid);
+  MPI_Comm_size(MPI_COMM_WORLD, &pnum);
+  vector<char> send_buffer;
+  PackWords(owned_words_, &send_buffer);
+  int send_size = send_buffer.size();
+  vector<int> sizes(pnum);
+  MPI_Gather(&send_size, 1, MPI_INT, &sizes[0], 1, MPI_INT, root,
+             MPI_COMM_WORLD);
+  vector<int> displacements = Displacements(sizes);
+  vector<char> receive_buffer;
+  if (myid == root) {
+    receive_buffer.resize(displacements[pnum - 1] + sizes[pnum - 1]);
+  }
+  MPI_Gatherv(Data(&send_buffer), send_size, MPI_CHAR,
+              Data(&receive_buffer), &sizes[0], &displacements[0], MPI_CHAR,
+              root, MPI_COMM_WORLD);
+  words->clear();
+  if (myid == root) {
+    // The owners' index ranges follow the process order.
+    words->reserve(num_words_);
+    for (int i = 0; i < receive_buffer.size();
+         i += strlen(&receive_buffer[i]) + 1) {
+      words->push_back(&receive_buffer[i]);
+    }
+  }
+}
+
+}  // namespace learning_lda
@@ -0,0 +1,67 @@
+// Copyright 2008 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef _OPENSOURCE_GLDA_DISTRIBUTED_VOCABULARY_H__
+#define _OPENSOURCE_GLDA_DISTRIBUTED_VOCABULARY_H__
+
+#include "mpi.h"
+
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "common.h"
+
+namespace learning_lda {
+
+// DistributedVocabulary assigns global indices to the words of the
+// corpora of all MPI processes without any process holding the whole
+// vocabulary.  Every word is owned by the process its hash selects.
+// Each process sends its local words to their owners with
+// MPI_Alltoallv; an owner sorts the distinct words it receives and
+// numbers them from an offset given by MPI_Exscan of the owners' word
+// counts, so process p owns the contiguous index range
+// [owned_begin(), owned_begin() + owned_words().size()).  The indices are
+// then sent back along the same route.
+class DistributedVocabulary {
+ public:
+  // Builds the vocabulary from the words of this process.  Collective.
+  explicit DistributedVocabulary(const std::set<string>& local_words);
+  ~DistributedVocabulary() {}
+
+  // Returns the global index of every local word.
+  const map<string, int>& word_index_map() const { return word_index_map_; }
+
+  // Returns the number of words of all processes.
+  int num_words() const { return num_words_; }
+
+  // Returns the words owned by this process, in index order.
+  const vector<string>& owned_words() const { return owned_words_; }
+  int owned_begin() const { return owned_begin_; }
+
+  // Sends all words to process root, which gets them in index order in
+  // words.  Only the process writing the model needs this.  Collective.
+  void Gather(int root, vector<string>* words) const;
+
+ private:
+  map<string, int> word_index_map_;
+  int num_words_;
+  vector<string> owned_words_;
+  int owned_begin_;
+};
+
+}  // namespace learning_lda
+
+#endif  // _OPENSOURCE_GLDA_DISTRIBUTED_VOCABULARY_H__
@@ -122,6 +122,22 @@ LDADocument::~LDADocument() {
   topic_assignments_ = NULL;
 }
 
+void LDADocument::Reallocate() {
+  DocumentWordTopicsPB* topic_assignments = new DocumentWordTopicsPB;
+  topic_assignments->CopyFrom(*topic_assignments_);
+  delete topic_assignments_;
+  topic_assignments_ = topic_assignments;
+  vector<int64>(topic_distribution_).swap(topic_distribution_);
+}
+
+void LDADocument::SetTopic(int index, int new_topic) {
+  CHECK_LE(0, new_topic);
+  CHECK_GT(topic_distribution_.size(), new_topic);
+  topic_distribution_[Topic(index)] -= 1;
+  topic_distribution_[new_topic] += 1;
+  *(topic_assignments_->mutable_wordtopics(index)) = new_topic;
+}
+
 void LDADocument::ResetWordIndex(const map<string, int>& word_index_map) {
   for (int i = 0; i < topic_assignments_->words_.size(); ++i) {
     (*topic_assignments_).words_[i] = word_index_map.find((*topic_assignments_).words_s_[i])->second;
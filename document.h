@@ -80,8 +80,23 @@ class LDADocument {
     return topic_distribution_;
   }
 
+  // Returns the topic of the index-th word occurrence, counted over
+  // topics().wordtopics_.
+  int Topic(int index) const {
+    return topic_assignments_->wordtopics(index);
+  }
+
+  // Changes the topic of the index-th word occurrence and keeps the
+  // topic distribution up to date.
+  void SetTopic(int index, int new_topic);
+
   void ResetWordIndex(const map<string, int>& word_index_map);
 
+  // Copies the topic assignments and distribution into memory allocated
+  // by the calling thread, which first touches it and so places it on
+  // its NUMA node.
+  void Reallocate();
+
   string DebugString();
  protected:
   DocumentWordTopicsPB*  topic_assignments_;
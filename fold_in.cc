@@ -0,0 +1,170 @@
+// Copyright 2008 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "fold_in.h"
+
+#include <math.h>
+
+#if defined(__AVX__) || defined(__SSE__)
+#include <immintrin.h>
+#endif
+
+namespace learning_lda {
+
+namespace {
+
+// Computes products[k] = theta[k] * probs[k] and returns their sum.
+float MultiplyAndSum(const float* theta, const float* probs,
+                     float* products, int size) {
+  int k = 0;
+  float sum = 0;
+#if defined(__AVX__)
+  __m256 sum8 = _mm256_setzero_ps();
+  for (; k + 8 <= size; k += 8) {
+    __m256 p = _mm256_mul_ps(_mm256_loadu_ps(theta + k),
+                             _mm256_loadu_ps(probs + k));
+    _mm256_storeu_ps(products + k, p);
+    sum8 = _mm256_add_ps(sum8, p);
+  }
+  float partial8[8];
+  _mm256_storeu_ps(partial8, sum8);
+  for (int i = 0; i < 8; ++i) {
+    sum += partial8[i];
+  }
+#elif defined(__SSE__)
+  __m128 sum4 = _mm_setzero_ps();
+  for (; k + 4 <= size; k += 4) {
+    __m128 p = _mm_mul_ps(_mm_loadu_ps(theta + k), _mm_loadu_ps(probs + k));
+    _mm_storeu_ps(products + k, p);
+    sum4 = _mm_add_ps(sum4, p);
+  }
+  float partial4[4];
+  _mm_storeu_ps(partial4, sum4);
+  sum += partial4[0] + partial4[1] + partial4[2] + partial4[3];
+#endif
+  for (; k < size; ++k) {
+    products[k] = theta[k] * probs[k];
+    sum += products[k];
+  }
+  return sum;
+}
+
+// Computes counts[k] += scale * products[k].
+void ScaleAndAdd(float scale, const float* products, float* counts,
+                 int size) {
+  int k = 0;
+#if defined(__AVX__)
+  __m256 scale8 = _mm256_set1_ps(scale);
+  for (; k + 8 <= size; k += 8) {
+    _mm256_storeu_ps(counts + k,
+                     _mm256_add_ps(_mm256_loadu_ps(counts + k),
+                                   _mm256_mul_ps(scale8,
+                                                 _mm256_loadu_ps(products + k))));
+  }
+#elif defined(__SSE__)
+  __m128 scale4 = _mm_set1_ps(scale);
+  for (; k + 4 <= size; k += 4) {
+    _mm_storeu_ps(counts + k,
+                  _mm_add_ps(_mm_loadu_ps(counts + k),
+                             _mm_mul_ps(scale4, _mm_loadu_ps(products + k))));
+  }
+#endif
+  for (; k < size; ++k) {
+    counts[k] += scale * products[k];
+  }
+}
+
+}  // namespace
+
+LDAFoldInEstimator::LDAFoldInEstimator(double alpha,
+                                       const LDAInferenceModel* model,
+                                       int max_iterations,
+                                       double tolerance)
+    : alpha_(alpha), model_(model), quantized_model_(NULL),
+      max_iterations_(max_iterations), tolerance_(tolerance) {
+  CHECK_LT(0.0, alpha);
+  CHECK(model != NULL);
+  CHECK_LT(0, max_iterations);
+}
+
+LDAFoldInEstimator::LDAFoldInEstimator(double alpha,
+                                       const LDAQuantizedModel* model,
+                                       int max_iterations,
+                                       double tolerance)
+    : alpha_(alpha), model_(NULL), quantized_model_(model),
+      max_iterations_(max_iterations), tolerance_(tolerance) {
+  CHECK_LT(0.0, alpha);
+  CHECK(model != NULL);
+  CHECK_LT(0, max_iterations);
+}
+
+int LDAFoldInEstimator::EstimateTopicCounts(
+    const DocumentWordTopicsPB& document,
+    TopicProbDistribution* topic_counts) const {
+  const int num_topics = this->num_topics();
+  const int document_length = document.wordtopics_size();
+  topic_counts->assign(num_topics, 0);
+  if (document_length == 0) {
+    return 0;
+  }
+
+  vector<float> theta(num_topics, 1.0 / num_topics);
+  vector<float> counts(num_topics);
+  vector<float> products(num_topics);
+  vector<float> word_topic_probs;
+  if (quantized_model_ != NULL) {
+    // Dequantize each word's probabilities only once per document.
+    word_topic_probs.resize(
+        static_cast<int64>(num_topics) * document.words_size());
+    for (int i = 0; i < document.words_size(); ++i) {
+      quantized_model_->GetRelativeWordTopicProbabilities(
+          document.word(i),
+          &word_topic_probs[static_cast<int64>(i) * num_topics]);
+    }
+  }
+  const double normalizer = 1.0 / (document_length + num_topics * alpha_);
+  int iteration = 0;
+  while (iteration < max_iterations_) {
+    ++iteration;
+    // E-step: distribute every unique word's count over topics.
+    counts.assign(num_topics, 0);
+    for (int i = 0; i < document.words_size(); ++i) {
+      int count = document.wordtopics_count(i);
+      if (count == 0) {
+        continue;
+      }
+      const float* probs = (model_ != NULL) ?
+          model_->GetWordTopicProbabilities(document.word(i)) :
+          &word_topic_probs[static_cast<int64>(i) * num_topics];
+      float sum = MultiplyAndSum(&theta[0], probs, &products[0], num_topics);
+      ScaleAndAdd(count / sum, &products[0], &counts[0], num_topics);
+    }
+    // M-step.
+    double change = 0;
+    for (int k = 0; k < num_topics; ++k) {
+      float new_theta = (counts[k] + alpha_) * normalizer;
+      change += fabs(new_theta - theta[k]);
+      theta[k] = new_theta;
+    }
+    if (change < tolerance_) {
+      break;
+    }
+  }
+  for (int k = 0; k < num_topics; ++k) {
+    (*topic_counts)[k] = counts[k];
+  }
+  return iteration;
+}
+
+}  // namespace learning_lda
@@ -0,0 +1,69 @@
+// Copyright 2008 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef _OPENSOURCE_GLDA_FOLD_IN_H__
+#define _OPENSOURCE_GLDA_FOLD_IN_H__
+
+#include "common.h"
+#include "inference_model.h"
+#include "quantized_model.h"
+
+namespace learning_lda {
+
+// LDAFoldInEstimator estimates the topic distribution theta of a query
+// document deterministically by expectation-maximization, holding the
+// word-topic probabilities P(w|z) of an LDAInferenceModel fixed.  Each
+// iteration computes, for every unique word w of the document with
+// count c_w, the topic responsibilities
+//   r_wk = theta_k * P(w|z=k) / sum_j theta_j * P(w|z=j)
+// and re-estimates
+//   n_k = sum_w c_w * r_wk,  theta_k = (n_k + alpha) / (N + K * alpha).
+// The work per iteration is proportional to the number of unique words
+// rather than the number of word occurrences, and the loops over topics
+// are vectorized.  P(w|z) is taken either from an LDAInferenceModel or,
+// up to a factor per word that cancels out in r_wk, from an
+// LDAQuantizedModel.
+class LDAFoldInEstimator {
+ public:
+  // Iterates at most max_iterations times, or until the L1 change of
+  // theta between two iterations falls below tolerance.
+  LDAFoldInEstimator(double alpha, const LDAInferenceModel* model,
+                     int max_iterations, double tolerance);
+  LDAFoldInEstimator(double alpha, const LDAQuantizedModel* model,
+                     int max_iterations, double tolerance);
+  ~LDAFoldInEstimator() {}
+
+  // Estimates the expected topic counts n_k of document, which sum to
+  // the document length like the topic counts averaged by Gibbs
+  // sampling.  Returns the number of iterations done.
+  int EstimateTopicCounts(const DocumentWordTopicsPB& document,
+                          TopicProbDistribution* topic_counts) const;
+
+ private:
+  int num_topics() const {
+    return model_ != NULL ? model_->num_topics() :
+        quantized_model_->num_topics();
+  }
+
+  const double alpha_;
+  // Exactly one of model_ and quantized_model_ is not NULL.
+  const LDAInferenceModel* model_;
+  const LDAQuantizedModel* quantized_model_;
+  const int max_iterations_;
+  const double tolerance_;
+};
+
+}  // namespace learning_lda
+
+#endif  // _OPENSOURCE_GLDA_FOLD_IN_H__
@@ -23,29 +23,22 @@
   --burn_in_iterations 10                              \
   --total_iterations 15
 */
+#include <algorithm>
 #include <fstream>
 #include <set>
 #include <sstream>
 #include <string>
 
 #include "common.h"
-#include "document.h"
-#include "model.h"
-#include "sampler.h"
+#include "inferencer.h"
 #include "cmd_flags.h"
 
 int main(int argc, char** argv) {
-  using learning_lda::LDACorpus;
-  using learning_lda::LDAModel;
-  using learning_lda::LDAAccumulativeModel;
-  using learning_lda::LDASampler;
-  using learning_lda::LDADocument;
+  using learning_lda::LDAInferencer;
   using learning_lda::LDACmdLineFlags;
-  using learning_lda::DocumentWordTopicsPB;
-  using learning_lda::RandInt;
+  using learning_lda::IsDocumentLine;
   using std::ifstream;
   using std::ofstream;
-  using std::istringstream;
 
   LDACmdLineFlags flags;
   flags.ParseCmdFlags(argc, argv);
@@ -53,49 +46,47 @@ int main(int argc, char** argv) {
     return -1;
   }
   srand(time(NULL));
-  map<string, int> word_index_map;
-  ifstream model_fin(flags.model_file_.c_str());
-  LDAModel model(model_fin, &word_index_map);
-  LDASampler sampler(flags.alpha_, flags.beta_, &model, NULL);
+  ifstream model_fin(flags.model_file_.c_str(), std::ios::binary);
+  LDAInferencer inferencer(model_fin, flags);
   ifstream fin(flags.inference_data_file_.c_str());
   ofstream out(flags.inference_result_file_.c_str());
+  double start_time = learning_lda::WallTime();
+  int num_documents = 0;
+  int64 num_iterations = 0;
+  int min_iterations = flags.total_iterations_;
+  int max_iterations = 0;
   string line;
   while (getline(fin, line)) {  // Each line is a training document.
-    if (line.size() > 0 &&      // Skip empty lines.
-        line[0] != '\r' &&      // Skip empty lines.
-        line[0] != '\n' &&      // Skip empty lines.
-        line[0] != '#') {       // Skip comment lines.
-      istringstream ss(line);
-      DocumentWordTopicsPB document_topics;
-      string word;
-      int count;
-      while (ss >> word >> count) {  // Load and init a document.
-        vector<int32> topics;
-        for (int i = 0; i < count; ++i) {
-          topics.push_back(RandInt(model.num_topics()));
-        }
-        map<string, int>::const_iterator iter = word_index_map.find(word);
-        if (iter != word_index_map.end()) {
-          document_topics.add_wordtopics(word, iter->second, topics);
-        }
-      }
-      LDADocument document(document_topics, model.num_topics());
-      TopicProbDistribution prob_dist(model.num_topics(), 0);
-      for (int iter = 0; iter < flags.total_iterations_; ++iter) {
-        sampler.SampleNewTopicsForDocument(&document, false);
-        if (iter >= flags.burn_in_iterations_) {
-          const vector<int64>& document_distribution =
-              document.topic_distribution();
-          for (int i = 0; i < document_distribution.size(); ++i) {
-            prob_dist[i] += document_distribution[i];
-          }
-        }
-      }
+    if (IsDocumentLine(line)) {
+      ++num_documents;
+      TopicProbDistribution prob_dist;
+      int iterations = inferencer.InferTopicDistribution(line, &prob_dist);
+      num_iterations += iterations;
+      min_iterations = std::min(min_iterations, iterations);
+      max_iterations = std::max(max_iterations, iterations);
       for (int topic = 0; topic < prob_dist.size(); ++topic) {
-        out << prob_dist[topic] /
-              (flags.total_iterations_ - flags.burn_in_iterations_)
-            << ((topic < prob_dist.size() - 1) ? " " : "\n");
+        out << prob_dist[topic]
+            << ((topic < prob_dist.size() - 1) ? " " : "");
       }
+      // The number of iterations is a diagnostic column after a tab.
+      if (flags.output_iterations_ == "true") {
+        out << "\t" << iterations;
+      }
+      out << "\n";
     }
   }
+  std::cout << "Inferred " << num_documents << " documents in "
+            << learning_lda::WallTime() - start_time << " seconds\n";
+  if (num_documents > 0) {
+    int64 max_total = static_cast<int64>(num_documents) *
+        flags.total_iterations_;
+    std::cout << "Iterations per document: mean "
+              << static_cast<double>(num_iterations) / num_documents
+              << " min " << min_iterations
+              << " max " << max_iterations
+              << ", saved " << max_total - num_iterations
+              << " of " << max_total << " iterations ("
+              << 100.0 * (max_total - num_iterations) / max_total
+              << "%)\n";
+  }
 }
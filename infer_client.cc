@@ -0,0 +1,191 @@
+// Copyright 2008 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+/*
+  A client and latency benchmark of infer_server.  An example running
+  of this program:
+
+  ./infer_client \
+  --server_socket /tmp/lda_infer.sock \
+  --inference_data_file ./testdata/test_data.txt \
+  --num_clients 8 \
+  --num_requests 10000
+
+  Each of the num_clients threads opens its own connection and sends
+  documents of inference_data_file one at a time, waiting for each
+  reply.  num_requests documents are sent in total (the data file is
+  cycled over as needed, and 0 means every document once).  The
+  round-trip latency percentiles and the throughput are printed in the
+  end, followed by the server-side statistics.
+*/
+
+#include <errno.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <fstream>
+#include <string>
+
+#include "common.h"
+#include "inferencer.h"
+#include "latency_stats.h"
+#include "cmd_flags.h"
+
+namespace learning_lda {
+
+// Connects to the Unix domain socket at path.  Returns -1 on failure.
+int ConnectUnixSocket(const string& path) {
+  struct sockaddr_un address;
+  memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+  strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path) - 1);
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0 ||
+      connect(fd, reinterpret_cast<struct sockaddr*>(&address),
+              sizeof(address)) < 0) {
+    std::cerr << "Failed to connect to " << path << ": "
+              << strerror(errno) << "\n";
+    if (fd >= 0) {
+      close(fd);
+    }
+    return -1;
+  }
+  return fd;
+}
+
+// Sends one request line and reads back one reply line.
+bool RoundTrip(int fd, const string& request, string* reply) {
+  string data = request + "\n";
+  size_t written = 0;
+  while (written < data.size()) {
+    int n = write(fd, data.data() + written, data.size() - written);
+    if (n <= 0) {
+      return false;
+    }
+    written += n;
+  }
+  reply->clear();
+  char c;
+  while (true) {
+    int n = read(fd, &c, 1);
+    if (n <= 0) {
+      return false;
+    }
+    if (c == '\n') {
+      return true;
+    }
+    reply->push_back(c);
+  }
+}
+
+struct ClientContext {
+  string server_socket;
+  const vector<string>* documents;
+  int first_request;
+  int num_requests;
+  LatencyStats* latency_stats;
+  bool ok;
+};
+
+void* ClientThread(void* arg) {
+  ClientContext* context = static_cast<ClientContext*>(arg);
+  context->ok = false;
+  int fd = ConnectUnixSocket(context->server_socket);
+  if (fd < 0) {
+    return NULL;
+  }
+  const vector<string>& documents = *context->documents;
+  string reply;
+  for (int i = 0; i < context->num_requests; ++i) {
+    const string& document =
+        documents[(context->first_request + i) % documents.size()];
+    double start = WallTime();
+    if (!RoundTrip(fd, document, &reply)) {
+      std::cerr << "Connection closed by server\n";
+      close(fd);
+      return NULL;
+    }
+    context->latency_stats->Add((WallTime() - start) * 1000);
+  }
+  close(fd);
+  context->ok = true;
+  return NULL;
+}
+
+}  // namespace learning_lda
+
+int main(int argc, char** argv) {
+  using learning_lda::LDACmdLineFlags;
+  using learning_lda::LatencyStats;
+  using learning_lda::ClientContext;
+  using learning_lda::IsDocumentLine;
+  using learning_lda::WallTime;
+
+  LDACmdLineFlags flags;
+  flags.ParseCmdFlags(argc, argv);
+  if (!flags.CheckClientValidity()) {
+    return -1;
+  }
+
+  vector<string> documents;
+  std::ifstream fin(flags.inference_data_file_.c_str());
+  string line;
+  while (getline(fin, line)) {
+    if (IsDocumentLine(line)) {
+      documents.push_back(line);
+    }
+  }
+  CHECK_GT(documents.size(), 0);
+  int num_requests = flags.num_requests_ > 0 ?
+      flags.num_requests_ : documents.size();
+
+  LatencyStats latency_stats;
+  vector<ClientContext> contexts(flags.num_clients_);
+  vector<pthread_t> threads(flags.num_clients_);
+  double start = WallTime();
+  for (int i = 0; i < threads.size(); ++i) {
+    contexts[i].server_socket = flags.server_socket_;
+    contexts[i].documents = &documents;
+    contexts[i].first_request =
+        static_cast<int64>(num_requests) * i / threads.size();
+    contexts[i].num_requests =
+        static_cast<int64>(num_requests) * (i + 1) / threads.size() -
+        contexts[i].first_request;
+    contexts[i].latency_stats = &latency_stats;
+    pthread_create(&threads[i], NULL, learning_lda::ClientThread,
+                   &contexts[i]);
+  }
+  bool ok = true;
+  for (int i = 0; i < threads.size(); ++i) {
+    pthread_join(threads[i], NULL);
+    ok = ok && contexts[i].ok;
+  }
+  double elapsed = WallTime() - start;
+
+  std::cout << "Client ";
+  latency_stats.AppendAsString(std::cout);
+  std::cout << " requests_per_second: " << latency_stats.count() / elapsed
+            << std::endl;
+
+  int fd = learning_lda::ConnectUnixSocket(flags.server_socket_);
+  string server_stats;
+  if (fd >= 0 && learning_lda::RoundTrip(fd, "#stats", &server_stats)) {
+    std::cout << "Server " << server_stats << std::endl;
+  }
+  if (fd >= 0) {
+    close(fd);
+  }
+  return ok ? 0 : -1;
+}
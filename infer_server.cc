@@ -0,0 +1,612 @@
+// Copyright 2008 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+/*
+  An example running of this program:
+
+  ./infer_server \
+  --alpha 0.1    \
+  --beta 0.01                                           \
+  --model_file /tmp/lda_model.txt                       \
+  --burn_in_iterations 10                              \
+  --total_iterations 15                                \
+  --num_threads 4                                      \
+  --server_socket /tmp/lda_infer.sock
+
+  The model is loaded once.  Each request is one document in the
+  training data format terminated by a newline, and the reply is one
+  line holding the inferred topic distribution, in the same format as
+  the inference_result_file of infer.  A request line "#stats" replies
+  with the latency percentiles of the requests served so far.  Without
+  --server_socket, requests are read from stdin and replies written to
+  stdout.  Latency percentiles are printed to stderr at shutdown.
+
+  With --pin_threads true, the workers are pinned to cores spread over
+  the NUMA nodes, and the requests per second of every node are printed
+  at shutdown.  --model_placement replicate then loads one copy of the
+  model per node, which the workers of the node read.
+*/
+
+#include <errno.h>
+#include <pthread.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <deque>
+#include <fstream>
+#include <list>
+#include <map>
+#include <sstream>
+#include <string>
+
+#include "common.h"
+#include "inferencer.h"
+#include "latency_stats.h"
+#include "numa_placement.h"
+#include "cmd_flags.h"
+
+namespace learning_lda {
+
+using std::deque;
+using std::ostringstream;
+
+// A client connection.  Requests of one connection may be served by
+// different workers, so replies are buffered and written back in the
+// order the requests arrived.  The writing is done by a thread of the
+// connection, so that a client which does not read its replies never
+// blocks a worker.  A connection is reference counted: its owner, its
+// writer and every request in flight hold one reference each.
+class Connection {
+ public:
+  // Starts the writer.  The caller owns the first reference.
+  Connection(int in_fd, int out_fd)
+      : in_fd_(in_fd), out_fd_(out_fd), buffer_begin_(0), buffer_end_(0),
+        num_read_(0), num_replied_(0), input_closed_(false),
+        broken_(false), finished_(false), references_(2) {
+    pthread_mutex_init(&mutex_, NULL);
+    pthread_cond_init(&output_ready_, NULL);
+    pthread_cond_init(&finished_cond_, NULL);
+    pthread_t writer;
+    pthread_create(&writer, NULL, WriterThread, this);
+    pthread_detach(writer);
+  }
+
+  // Reads a line without its trailing newline.  Returns false at the end
+  // of input.  Only called by the reader.
+  bool ReadLine(string* line) {
+    line->clear();
+    while (true) {
+      for (int i = buffer_begin_; i < buffer_end_; ++i) {
+        if (buffer_[i] == '\n') {
+          line->append(buffer_ + buffer_begin_, i - buffer_begin_);
+          buffer_begin_ = i + 1;
+          return true;
+        }
+      }
+      line->append(buffer_ + buffer_begin_, buffer_end_ - buffer_begin_);
+      buffer_begin_ = buffer_end_ = 0;
+      int n = read(in_fd_, buffer_, sizeof(buffer_));
+      if (n < 0 && errno == EINTR) {
+        continue;
+      }
+      if (n <= 0) {
+        return !line->empty();
+      }
+      buffer_end_ = n;
+    }
+  }
+
+  // Returns the sequence number of a newly read request and keeps the
+  // connection alive until the request is replied.
+  int64 NewRequest() {
+    pthread_mutex_lock(&mutex_);
+    ++references_;
+    int64 sequence = num_read_++;
+    pthread_mutex_unlock(&mutex_);
+    return sequence;
+  }
+
+  // Called by the reader after its last request.
+  void CloseInput() {
+    pthread_mutex_lock(&mutex_);
+    input_closed_ = true;
+    pthread_cond_signal(&output_ready_);
+    pthread_mutex_unlock(&mutex_);
+  }
+
+  // Queues the reply of request sequence, and all replies that are next
+  // in order, for the writer.
+  void Reply(int64 sequence, const string& reply) {
+    pthread_mutex_lock(&mutex_);
+    pending_replies_[sequence] = reply;
+    for (map<int64, string>::iterator iter = pending_replies_.begin();
+         iter != pending_replies_.end() && iter->first == num_replied_;
+         pending_replies_.erase(iter++)) {
+      if (!broken_) {
+        output_.append(iter->second);
+      }
+      ++num_replied_;
+    }
+    pthread_cond_signal(&output_ready_);
+    pthread_mutex_unlock(&mutex_);
+    Release();
+  }
+
+  // Makes blocked reads and writes of a socket connection return, so
+  // that the connection finishes soon.
+  void Shutdown() {
+    shutdown(in_fd_, SHUT_RDWR);
+  }
+
+  // Blocks until the input is closed and every reply is written out or
+  // dropped.
+  void WaitUntilFinished() {
+    pthread_mutex_lock(&mutex_);
+    while (!finished_) {
+      pthread_cond_wait(&finished_cond_, &mutex_);
+    }
+    pthread_mutex_unlock(&mutex_);
+  }
+
+  bool finished() {
+    pthread_mutex_lock(&mutex_);
+    bool finished = finished_;
+    pthread_mutex_unlock(&mutex_);
+    return finished;
+  }
+
+  // Drops one reference.
+  void Release() {
+    pthread_mutex_lock(&mutex_);
+    bool done = (--references_ == 0);
+    pthread_mutex_unlock(&mutex_);
+    if (done) {
+      delete this;
+    }
+  }
+
+ private:
+  ~Connection() {
+    if (in_fd_ != STDIN_FILENO) {
+      close(in_fd_);
+    }
+    pthread_cond_destroy(&finished_cond_);
+    pthread_cond_destroy(&output_ready_);
+    pthread_mutex_destroy(&mutex_);
+  }
+
+  static void* WriterThread(void* arg) {
+    static_cast<Connection*>(arg)->WriteReplies();
+    return NULL;
+  }
+
+  // Writes out the queued replies until the input is closed and every
+  // request is replied.  The replies of a client that has gone away are
+  // dropped.
+  void WriteReplies() {
+    pthread_mutex_lock(&mutex_);
+    while (true) {
+      while (output_.empty() &&
+             !(input_closed_ && num_replied_ == num_read_)) {
+        pthread_cond_wait(&output_ready_, &mutex_);
+      }
+      if (output_.empty()) {
+        break;
+      }
+      string data;
+      data.swap(output_);
+      pthread_mutex_unlock(&mutex_);
+      bool written = WriteFully(data);
+      pthread_mutex_lock(&mutex_);
+      if (!written) {
+        broken_ = true;
+        output_.clear();
+      }
+    }
+    finished_ = true;
+    pthread_cond_broadcast(&finished_cond_);
+    pthread_mutex_unlock(&mutex_);
+    Release();
+  }
+
+  // Returns false if the client has gone away.
+  bool WriteFully(const string& data) {
+    size_t written = 0;
+    while (written < data.size()) {
+      int n = write(out_fd_, data.data() + written, data.size() - written);
+      if (n < 0 && errno == EINTR) {
+        continue;
+      }
+      if (n <= 0) {
+        return false;
+      }
+      written += n;
+    }
+    return true;
+  }
+
+  int in_fd_;
+  int out_fd_;
+  char buffer_[1 << 16];
+  int buffer_begin_;
+  int buffer_end_;
+  int64 num_read_;
+  int64 num_replied_;
+  bool input_closed_;
+  // Whether a write has failed.
+  bool broken_;
+  bool finished_;
+  int references_;
+  map<int64, string> pending_replies_;
+  // The replies in order that are not written yet.
+  string output_;
+  pthread_mutex_t mutex_;
+  pthread_cond_t output_ready_;
+  pthread_cond_t finished_cond_;
+};
+
+struct InferenceRequest {
+  Connection* connection;
+  int64 sequence;
+  string document;
+  double arrival_time;
+};
+
+// A blocking queue of requests shared by readers and workers.  Workers
+// take requests in batches to amortize the synchronization cost.
+class RequestQueue {
+ public:
+  RequestQueue() : closed_(false) {
+    pthread_mutex_init(&mutex_, NULL);
+    pthread_cond_init(&not_empty_, NULL);
+  }
+  ~RequestQueue() {
+    pthread_cond_destroy(&not_empty_);
+    pthread_mutex_destroy(&mutex_);
+  }
+
+  void Push(InferenceRequest* request) {
+    pthread_mutex_lock(&mutex_);
+    requests_.push_back(request);
+    pthread_cond_signal(&not_empty_);
+    pthread_mutex_unlock(&mutex_);
+  }
+
+  // Blocks until there is a request, then takes up to max_size requests.
+  // Returns false once the queue is closed and empty.
+  bool PopBatch(int max_size, vector<InferenceRequest*>* batch) {
+    batch->clear();
+    pthread_mutex_lock(&mutex_);
+    while (requests_.empty() && !closed_) {
+      pthread_cond_wait(&not_empty_, &mutex_);
+    }
+    while (!requests_.empty() && batch->size() < max_size) {
+      batch->push_back(requests_.front());
+      requests_.pop_front();
+    }
+    pthread_mutex_unlock(&mutex_);
+    return !batch->empty();
+  }
+
+  void Close() {
+    pthread_mutex_lock(&mutex_);
+    closed_ = true;
+    pthread_cond_broadcast(&not_empty_);
+    pthread_mutex_unlock(&mutex_);
+  }
+
+ private:
+  deque<InferenceRequest*> requests_;
+  bool closed_;
+  pthread_mutex_t mutex_;
+  pthread_cond_t not_empty_;
+};
+
+struct ServerContext {
+  RequestQueue* queue;
+  LatencyStats* latency_stats;
+  int batch_size;
+};
+
+struct WorkerContext {
+  ServerContext* server;
+  const LDAInferencer* inferencer;
+  // The CPU to pin to, or -1.
+  int cpu;
+  int64 num_requests;
+};
+
+struct ReaderContext {
+  ServerContext* server;
+  Connection* connection;
+  pthread_t thread;
+};
+
+// Reads the requests of a connection and queues them.
+void ReadRequests(ServerContext* server, Connection* connection) {
+  string line;
+  while (connection->ReadLine(&line)) {
+    if (line.size() > 0 && line[line.size() - 1] == '\r') {
+      line.resize(line.size() - 1);
+    }
+    InferenceRequest* request = new InferenceRequest;
+    request->connection = connection;
+    request->sequence = connection->NewRequest();
+    request->document = line;
+    request->arrival_time = WallTime();
+    server->queue->Push(request);
+  }
+  connection->CloseInput();
+}
+
+void* ReaderThread(void* arg) {
+  ReaderContext* context = static_cast<ReaderContext*>(arg);
+  ReadRequests(context->server, context->connection);
+  return NULL;
+}
+
+void* WorkerThread(void* arg) {
+  WorkerContext* context = static_cast<WorkerContext*>(arg);
+  ServerContext* server = context->server;
+  if (context->cpu >= 0 && !PinThreadToCpu(context->cpu)) {
+    LOG(WARNING) << "Failed to pin a worker to CPU " << context->cpu
+                 << "\n";
+  }
+  vector<InferenceRequest*> batch;
+  TopicProbDistribution prob_dist;
+  while (server->queue->PopBatch(server->batch_size, &batch)) {
+    for (int i = 0; i < batch.size(); ++i) {
+      InferenceRequest* request = batch[i];
+      ostringstream reply;
+      const bool is_stats = request->document == "#stats";
+      if (is_stats) {
+        server->latency_stats->AppendAsString(reply);
+        reply << "\n";
+      } else {
+        context->inferencer->InferTopicDistribution(request->document,
+                                                    &prob_dist);
+        for (int topic = 0; topic < prob_dist.size(); ++topic) {
+          reply << prob_dist[topic]
+                << ((topic < prob_dist.size() - 1) ? " " : "\n");
+        }
+      }
+      request->connection->Reply(request->sequence, reply.str());
+      // The statistics only cover inference requests.
+      if (!is_stats) {
+        server->latency_stats->Add(
+            (WallTime() - request->arrival_time) * 1000);
+      }
+      delete request;
+      ++context->num_requests;
+    }
+  }
+  return NULL;
+}
+
+struct LoadContext {
+  const LDACmdLineFlags* flags;
+  // The CPU to load on, so that the model is placed on its node.
+  int cpu;
+  LDAInferencer* inferencer;
+};
+
+void* LoadThread(void* arg) {
+  LoadContext* context = static_cast<LoadContext*>(arg);
+  if (!PinThreadToCpu(context->cpu)) {
+    LOG(WARNING) << "Failed to pin a loading thread to CPU " << context->cpu
+                 << "\n";
+  }
+  std::ifstream model_fin(context->flags->model_file_.c_str(),
+                          std::ios::binary);
+  context->inferencer = new LDAInferencer(model_fin, *context->flags);
+  return NULL;
+}
+
+volatile sig_atomic_t shutdown_requested = 0;
+int listen_fd = -1;
+
+void HandleShutdownSignal(int) {
+  shutdown_requested = 1;
+  if (listen_fd >= 0) {
+    shutdown(listen_fd, SHUT_RDWR);
+  }
+}
+
+// Joins the reader of a finished connection and drops the reference of
+// the server.
+void ReleaseReader(ReaderContext* reader) {
+  pthread_join(reader->thread, NULL);
+  reader->connection->Release();
+  delete reader;
+}
+
+// Accepts connections on a Unix domain socket until shutdown is
+// requested, and starts a reader thread for each of them.  At shutdown,
+// the connections still open are shut down, and returns after their
+// readers have exited and their queued requests have been replied, so
+// that nothing is pushed to server->queue any more.
+int ServeUnixSocket(const string& path, ServerContext* server) {
+  struct sockaddr_un address;
+  if (path.size() >= sizeof(address.sun_path)) {
+    std::cerr << "server_socket path is too long: " << path << "\n";
+    return -1;
+  }
+  memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+  strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path) - 1);
+  unlink(path.c_str());
+  listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (listen_fd < 0 ||
+      bind(listen_fd, reinterpret_cast<struct sockaddr*>(&address),
+           sizeof(address)) < 0 ||
+      listen(listen_fd, SOMAXCONN) < 0) {
+    std::cerr << "Failed to listen on " << path << ": "
+              << strerror(errno) << "\n";
+    return -1;
+  }
+  std::cerr << "Serving on " << path << "\n";
+  list<ReaderContext*> readers;
+  while (!shutdown_requested) {
+    int fd = accept(listen_fd, NULL, NULL);
+    if (fd < 0) {
+      if (errno == EINTR || errno == ECONNABORTED) {
+        continue;
+      }
+      break;
+    }
+    for (list<ReaderContext*>::iterator iter = readers.begin();
+         iter != readers.end();) {
+      if ((*iter)->connection->finished()) {
+        ReleaseReader(*iter);
+        iter = readers.erase(iter);
+      } else {
+        ++iter;
+      }
+    }
+    ReaderContext* reader = new ReaderContext;
+    reader->server = server;
+    reader->connection = new Connection(fd, fd);
+    pthread_create(&reader->thread, NULL, ReaderThread, reader);
+    readers.push_back(reader);
+  }
+  for (list<ReaderContext*>::iterator iter = readers.begin();
+       iter != readers.end(); ++iter) {
+    (*iter)->connection->Shutdown();
+  }
+  for (list<ReaderContext*>::iterator iter = readers.begin();
+       iter != readers.end(); ++iter) {
+    (*iter)->connection->WaitUntilFinished();
+    ReleaseReader(*iter);
+  }
+  close(listen_fd);
+  unlink(path.c_str());
+  return 0;
+}
+
+}  // namespace learning_lda
+
+int main(int argc, char** argv) {
+  using learning_lda::LDAInferencer;
+  using learning_lda::LDACmdLineFlags;
+  using learning_lda::LatencyStats;
+  using learning_lda::RequestQueue;
+  using learning_lda::ServerContext;
+  using learning_lda::WorkerContext;
+  using learning_lda::LoadContext;
+  using learning_lda::Connection;
+  using learning_lda::NumaTopology;
+  using learning_lda::ScopedInterleavedMemory;
+  using std::ifstream;
+
+  LDACmdLineFlags flags;
+  flags.ParseCmdFlags(argc, argv);
+  if (!flags.CheckServingValidity()) {
+    return -1;
+  }
+  srand(time(NULL));
+  signal(SIGPIPE, SIG_IGN);
+
+  learning_lda::SetHugePages(flags.huge_pages_ == "true");
+  NumaTopology topology;
+  const bool pin_threads = flags.pin_threads_ == "true";
+
+  // With the replicate model_placement, inferencers[n] is loaded by a
+  // thread on NUMA node n.  Otherwise there is one inferencer.
+  double load_start = learning_lda::WallTime();
+  vector<LDAInferencer*> inferencers;
+  if (flags.model_placement_ == "replicate") {
+    vector<LoadContext> loads(topology.num_nodes());
+    vector<pthread_t> loaders(topology.num_nodes());
+    for (int n = 0; n < loads.size(); ++n) {
+      loads[n].flags = &flags;
+      loads[n].cpu = topology.ThreadCpu(n);
+      pthread_create(&loaders[n], NULL, learning_lda::LoadThread, &loads[n]);
+    }
+    for (int n = 0; n < loads.size(); ++n) {
+      pthread_join(loaders[n], NULL);
+      inferencers.push_back(loads[n].inferencer);
+    }
+  } else {
+    ScopedInterleavedMemory interleaved(
+        flags.model_placement_ == "interleave");
+    ifstream model_fin(flags.model_file_.c_str(), std::ios::binary);
+    inferencers.push_back(new LDAInferencer(model_fin, flags));
+  }
+  std::cerr << "Model loaded in " << learning_lda::WallTime() - load_start
+            << " seconds: " << inferencers[0]->num_words() << " words, "
+            << inferencers[0]->num_topics() << " topics";
+  if (inferencers.size() > 1) {
+    std::cerr << ", one copy on each of " << inferencers.size()
+              << " NUMA nodes";
+  }
+  std::cerr << "\n";
+
+  RequestQueue queue;
+  LatencyStats latency_stats;
+  ServerContext server;
+  server.queue = &queue;
+  server.latency_stats = &latency_stats;
+  server.batch_size = flags.batch_size_;
+  vector<WorkerContext> contexts(flags.num_threads_);
+  vector<pthread_t> workers(flags.num_threads_);
+  double serve_start = learning_lda::WallTime();
+  for (int i = 0; i < workers.size(); ++i) {
+    contexts[i].server = &server;
+    contexts[i].inferencer =
+        inferencers[inferencers.size() > 1 ? topology.ThreadNode(i) : 0];
+    contexts[i].cpu = pin_threads ? topology.ThreadCpu(i) : -1;
+    contexts[i].num_requests = 0;
+    pthread_create(&workers[i], NULL, learning_lda::WorkerThread,
+                   &contexts[i]);
+  }
+
+  int ret = 0;
+  if (flags.server_socket_.empty()) {
+    Connection* connection = new Connection(STDIN_FILENO, STDOUT_FILENO);
+    learning_lda::ReadRequests(&server, connection);
+    connection->WaitUntilFinished();
+    connection->Release();
+  } else {
+    signal(SIGINT, learning_lda::HandleShutdownSignal);
+    signal(SIGTERM, learning_lda::HandleShutdownSignal);
+    ret = learning_lda::ServeUnixSocket(flags.server_socket_, &server);
+  }
+  // No reader is left, so the queue is empty.
+  queue.Close();
+  for (int i = 0; i < workers.size(); ++i) {
+    pthread_join(workers[i], NULL);
+  }
+  double serve_time = learning_lda::WallTime() - serve_start;
+  std::cerr << "Latency ";
+  latency_stats.AppendAsString(std::cerr);
+  std::cerr << "\n";
+  if (pin_threads) {
+    vector<int64> node_requests(topology.num_nodes(), 0);
+    vector<int> node_workers(topology.num_nodes(), 0);
+    for (int i = 0; i < contexts.size(); ++i) {
+      node_requests[topology.ThreadNode(i)] += contexts[i].num_requests;
+      ++node_workers[topology.ThreadNode(i)];
+    }
+    for (int n = 0; n < topology.num_nodes(); ++n) {
+      std::cerr << "NUMA node " << n << ": " << node_workers[n]
+                << " workers, " << node_requests[n] / serve_time
+                << " requests per second\n";
+    }
+  }
+  for (int n = 0; n < inferencers.size(); ++n) {
+    delete inferencers[n];
+  }
+  return ret;
+}
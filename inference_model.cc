@@ -0,0 +1,95 @@
+// Copyright 2008 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "inference_model.h"
+
+namespace learning_lda {
+
+LDAInferenceModel::LDAInferenceModel(const LDAModel& model, double beta,
+                                     bool build_alias_tables)
+    : num_topics_(model.num_topics()),
+      num_words_(model.num_words()) {
+  CHECK_LT(0.0, beta);
+  int64 size = static_cast<int64>(num_topics_) * num_words_;
+  word_topic_probs_.resize(size);
+  if (build_alias_tables) {
+    alias_probs_.resize(size);
+    alias_topics_.resize(size);
+  }
+
+  const TopicCountDistribution& global_distribution =
+      model.GetGlobalTopicDistribution();
+  vector<double> inverse_denominator(num_topics_);
+  for (int k = 0; k < num_topics_; ++k) {
+    inverse_denominator[k] =
+        1.0 / (global_distribution[k] + num_words_ * beta);
+  }
+  for (LDAModel::Iterator iter(&model); !iter.Done(); iter.Next()) {
+    int64 offset = static_cast<int64>(iter.Word()) * num_topics_;
+    const TopicCountDistribution& word_distribution = iter.Distribution();
+    for (int k = 0; k < num_topics_; ++k) {
+      word_topic_probs_[offset + k] =
+          (word_distribution[k] + beta) * inverse_denominator[k];
+    }
+    if (build_alias_tables) {
+      BuildAliasTable(&word_topic_probs_[offset], &alias_probs_[offset],
+                      &alias_topics_[offset]);
+    }
+  }
+}
+
+void LDAInferenceModel::BuildAliasTable(const float* probs,
+                                        float* alias_probs,
+                                        int32* alias_topics) {
+  double sum = 0;
+  for (int k = 0; k < num_topics_; ++k) {
+    sum += probs[k];
+  }
+  // Scale probabilities so that they average to 1, then repeatedly fill
+  // up an underfull slot with the excess of an overfull one.
+  vector<double> scaled(num_topics_);
+  vector<int> small;
+  vector<int> large;
+  for (int k = 0; k < num_topics_; ++k) {
+    scaled[k] = probs[k] * num_topics_ / sum;
+    if (scaled[k] < 1.0) {
+      small.push_back(k);
+    } else {
+      large.push_back(k);
+    }
+  }
+  while (!small.empty() && !large.empty()) {
+    int less = small.back();
+    small.pop_back();
+    int more = large.back();
+    alias_probs[less] = scaled[less];
+    alias_topics[less] = more;
+    scaled[more] -= 1.0 - scaled[less];
+    if (scaled[more] < 1.0) {
+      large.pop_back();
+      small.push_back(more);
+    }
+  }
+  // What is left is 1 up to rounding errors.
+  for (int i = 0; i < large.size(); ++i) {
+    alias_probs[large[i]] = 1;
+    alias_topics[large[i]] = large[i];
+  }
+  for (int i = 0; i < small.size(); ++i) {
+    alias_probs[small[i]] = 1;
+    alias_topics[small[i]] = small[i];
+  }
+}
+
+}  // namespace learning_lda
@@ -0,0 +1,83 @@
+// Copyright 2008 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef _OPENSOURCE_GLDA_INFERENCE_MODEL_H__
+#define _OPENSOURCE_GLDA_INFERENCE_MODEL_H__
+
+#include <vector>
+
+#include "common.h"
+#include "model.h"
+
+namespace learning_lda {
+
+// LDAInferenceModel is a read-only form of an LDAModel prepared for
+// inference.  Since the model never changes during inference, the
+// word-topic probabilities
+//   P(w|z=k) = (n_wk + beta) / (n_k + V * beta)
+// are computed once at load time and stored as floats.  Optionally every
+// word gets an alias table over topics, from which a topic can be drawn
+// with probability proportional to P(w|z) in constant time.
+//
+// This class is thread-safe once constructed.
+class LDAInferenceModel {
+ public:
+  // If build_alias_tables is false, SampleTopicForWord must not be
+  // used.
+  LDAInferenceModel(const LDAModel& model, double beta,
+                    bool build_alias_tables);
+  ~LDAInferenceModel() {}
+
+  // Returns the num_topics() values P(word|z=k) of word.
+  const float* GetWordTopicProbabilities(int word) const {
+    return &word_topic_probs_[static_cast<int64>(word) * num_topics_];
+  }
+
+  // Draws a topic k with probability proportional to P(word|z=k).
+  int SampleTopicForWord(int word) const {
+    int64 offset = static_cast<int64>(word) * num_topics_;
+    double u = RandDouble() * num_topics_;
+    int k = static_cast<int>(u);
+    return (u - k < alias_probs_[offset + k]) ?
+        k : alias_topics_[offset + k];
+  }
+
+  // Returns the number of topics in the model.
+  int num_topics() const { return num_topics_; }
+
+  // Returns the number of words in the model.
+  int num_words() const { return num_words_; }
+
+ private:
+  // Builds the alias table of one word from its topic probabilities by
+  // Vose's method.
+  void BuildAliasTable(const float* probs, float* alias_probs,
+                       int32* alias_topics);
+
+  int num_topics_;
+  int num_words_;
+
+  // word_topic_probs_[w * num_topics_ + k] = P(w|z=k).
+  vector<float> word_topic_probs_;
+
+  // The alias tables: a slot k of word w keeps topic k with probability
+  // alias_probs_[w * num_topics_ + k], or yields
+  // alias_topics_[w * num_topics_ + k] otherwise.
+  vector<float> alias_probs_;
+  vector<int32> alias_topics_;
+};
+
+}  // namespace learning_lda
+
+#endif  // _OPENSOURCE_GLDA_INFERENCE_MODEL_H__
@@ -0,0 +1,158 @@
+// Copyright 2008 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "inferencer.h"
+
+#include <math.h>
+
+#include <sstream>
+
+#include "document.h"
+
+namespace learning_lda {
+
+LDAInferencer::LDAInferencer(std::istream& model_in,
+                             const LDACmdLineFlags& flags)
+    : burn_in_iterations_(flags.burn_in_iterations_),
+      total_iterations_(flags.total_iterations_),
+      convergence_tolerance_(flags.convergence_tolerance_),
+      model_(NULL),
+      sampler_(NULL),
+      inference_model_(NULL),
+      alias_sampler_(NULL),
+      fold_in_(NULL),
+      quantized_model_(NULL),
+      quantized_sampler_(NULL) {
+  CHECK_LT(burn_in_iterations_, total_iterations_);
+  vocabulary_filter_.ReadHeader(model_in);
+  if (LDAQuantizedModel::IsQuantizedModel(model_in)) {
+    quantized_model_ = new LDAQuantizedModel(model_in, &word_index_map_);
+    num_topics_ = quantized_model_->num_topics();
+    if (flags.inference_method_ == "em") {
+      fold_in_ = new LDAFoldInEstimator(flags.alpha_, quantized_model_,
+                                        total_iterations_,
+                                        flags.convergence_tolerance_);
+    } else if (flags.inference_method_ == "gibbs") {
+      quantized_sampler_ = new LDAQuantizedSampler(flags.alpha_,
+                                                   quantized_model_);
+    } else {
+      LOG(FATAL) << "inference_method " << flags.inference_method_
+                 << " does not support quantized models";
+    }
+    return;
+  }
+  model_ = new LDAModel(model_in, &word_index_map_);
+  num_topics_ = model_->num_topics();
+  if (flags.inference_method_ == "alias") {
+    inference_model_ = new LDAInferenceModel(*model_, flags.beta_, true);
+    alias_sampler_ = new LDAAliasSampler(flags.alpha_, inference_model_,
+                                         flags.mh_steps_);
+  } else if (flags.inference_method_ == "em") {
+    inference_model_ = new LDAInferenceModel(*model_, flags.beta_, false);
+    fold_in_ = new LDAFoldInEstimator(flags.alpha_, inference_model_,
+                                      total_iterations_,
+                                      flags.convergence_tolerance_);
+  } else {
+    CHECK(flags.inference_method_ == "gibbs");
+    sampler_ = new LDASampler(flags.alpha_, flags.beta_, model_, NULL);
+  }
+  if (inference_model_ != NULL) {
+    // Inference only needs the precomputed model.
+    delete model_;
+    model_ = NULL;
+  }
+}
+
+LDAInferencer::~LDAInferencer() {
+  delete quantized_sampler_;
+  delete quantized_model_;
+  delete fold_in_;
+  delete alias_sampler_;
+  delete inference_model_;
+  delete sampler_;
+  delete model_;
+}
+
+void LDAInferencer::ParseDocument(const string& line,
+                                  DocumentWordTopicsPB* document_topics) const {
+  std::istringstream ss(line);
+  string word;
+  string model_word;
+  int count;
+  while (ss >> word >> count) {  // Load and init a document.
+    if (!vocabulary_filter_.Map(word, &model_word)) {
+      continue;
+    }
+    map<string, int>::const_iterator iter = word_index_map_.find(model_word);
+    if (iter != word_index_map_.end()) {
+      vector<int32> topics;
+      for (int i = 0; i < count; ++i) {
+        topics.push_back(RandInt(num_topics_));
+      }
+      document_topics->add_wordtopics(model_word, iter->second, topics);
+    }
+  }
+}
+
+int LDAInferencer::InferTopicDistribution(
+    const string& line, TopicProbDistribution* prob_dist) const {
+  DocumentWordTopicsPB document_topics;
+  ParseDocument(line, &document_topics);
+  if (fold_in_ != NULL) {
+    return fold_in_->EstimateTopicCounts(document_topics, prob_dist);
+  }
+  LDADocument document(document_topics, num_topics_);
+  const int64 document_length = document_topics.wordtopics_size();
+  prob_dist->assign(num_topics_, 0);
+  // The running estimate of the normalized topic distribution.
+  vector<double> estimate(num_topics_, 0);
+  int num_accumulations = 0;
+  int iter = 0;
+  while (iter < total_iterations_) {
+    if (alias_sampler_ != NULL) {
+      alias_sampler_->SampleNewTopicsForDocument(&document);
+    } else if (quantized_sampler_ != NULL) {
+      quantized_sampler_->SampleNewTopicsForDocument(&document);
+    } else {
+      sampler_->SampleNewTopicsForDocument(&document, false);
+    }
+    ++iter;
+    if (iter > burn_in_iterations_) {
+      const vector<int64>& document_distribution =
+          document.topic_distribution();
+      for (int i = 0; i < document_distribution.size(); ++i) {
+        (*prob_dist)[i] += document_distribution[i];
+      }
+      ++num_accumulations;
+      if (convergence_tolerance_ > 0 && document_length > 0) {
+        double change = 0;
+        for (int i = 0; i < num_topics_; ++i) {
+          double new_estimate =
+              (*prob_dist)[i] / (num_accumulations * document_length);
+          change += fabs(new_estimate - estimate[i]);
+          estimate[i] = new_estimate;
+        }
+        if (num_accumulations > 1 && change < convergence_tolerance_) {
+          break;
+        }
+      }
+    }
+  }
+  for (int topic = 0; topic < prob_dist->size(); ++topic) {
+    (*prob_dist)[topic] /= num_accumulations;
+  }
+  return iter;
+}
+
+}  // namespace learning_lda
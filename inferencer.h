@@ -0,0 +1,110 @@
+// Copyright 2008 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef _OPENSOURCE_GLDA_INFERENCER_H__
+#define _OPENSOURCE_GLDA_INFERENCER_H__
+
+#include <iostream>
+#include <map>
+#include <string>
+
+#include "common.h"
+#include "model.h"
+#include "sampler.h"
+#include "inference_model.h"
+#include "alias_sampler.h"
+#include "fold_in.h"
+#include "quantized_model.h"
+#include "vocabulary.h"
+#include "cmd_flags.h"
+
+namespace learning_lda {
+
+// LDAInferencer infers the topic distribution of unseen documents with
+// a trained model.  Inference never modifies the model, so one
+// LDAInferencer can be shared by several threads once constructed.
+//
+// The inference method is chosen by --inference_method:
+//   gibbs: Gibbs sampling with LDASampler on the raw model counts.
+//   alias: Metropolis-Hastings sampling with LDAAliasSampler on an
+//          LDAInferenceModel precomputed at load time.
+//   em:    Deterministic fold-in with LDAFoldInEstimator, iterating at
+//          most total_iterations times, or until theta changes less than
+//          convergence_tolerance.
+// If the model is an LDAQuantizedModel written by quantize_model, gibbs
+// samples with LDAQuantizedSampler and em works on the quantized
+// probabilities; alias is not supported.
+class LDAInferencer {
+ public:
+  // Loads the model, in text or quantized format, from model_in and
+  // prepares the inference method.
+  // alpha, beta, burn_in_iterations, total_iterations,
+  // inference_method, mh_steps and convergence_tolerance are taken from
+  // flags.  The last
+  // (total_iterations - burn_in_iterations) sampling iterations are
+  // averaged into the inferred distribution.
+  LDAInferencer(std::istream& model_in, const LDACmdLineFlags& flags);
+
+  ~LDAInferencer();
+
+  // Parses a document in the training data format, i.e.,
+  // "<word1> <count1> <word2> <count2> ...", and assigns a random topic
+  // to every occurrence.  The words are mapped by the vocabulary filter
+  // the model was trained with, and words not in the model vocabulary
+  // are dropped.
+  void ParseDocument(const string& line,
+                     DocumentWordTopicsPB* document_topics) const;
+
+  // Infers the topic distribution of a document given as a line in the
+  // training data format.  Returns the number of iterations done.
+  //
+  // With a positive convergence_tolerance, sampling methods stop a
+  // document early once the L1 change of its running topic distribution
+  // estimate, i.e., the normalized average of the topic counts since
+  // the burn-in period, falls below the tolerance.
+  int InferTopicDistribution(const string& line,
+                             TopicProbDistribution* prob_dist) const;
+
+  int num_topics() const { return num_topics_; }
+  int num_words() const { return word_index_map_.size(); }
+
+ private:
+  map<string, int> word_index_map_;
+  VocabularyFilter vocabulary_filter_;
+  int num_topics_;
+  const int burn_in_iterations_;
+  const int total_iterations_;
+  const double convergence_tolerance_;
+
+  LDAModel* model_;
+  LDASampler* sampler_;
+  LDAInferenceModel* inference_model_;
+  LDAAliasSampler* alias_sampler_;
+  LDAFoldInEstimator* fold_in_;
+  LDAQuantizedModel* quantized_model_;
+  LDAQuantizedSampler* quantized_sampler_;
+};
+
+// Returns true if line contains a document, i.e., it is neither empty
+// nor a comment line.
+inline bool IsDocumentLine(const string& line) {
+  return line.size() > 0 &&      // Skip empty lines.
+      line[0] != '\r' &&         // Skip empty lines.
+      line[0] != '\n' &&         // Skip empty lines.
+      line[0] != '#';            // Skip comment lines.
+}
+
+}  // namespace learning_lda
+
+#endif  // _OPENSOURCE_GLDA_INFERENCER_H__
@@ -0,0 +1,77 @@
+// Copyright 2008 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "latency_stats.h"
+
+#include <algorithm>
+
+namespace learning_lda {
+
+LatencyStats::LatencyStats() {
+  pthread_mutex_init(&mutex_, NULL);
+}
+
+LatencyStats::~LatencyStats() {
+  pthread_mutex_destroy(&mutex_);
+}
+
+void LatencyStats::Add(double latency_ms) {
+  pthread_mutex_lock(&mutex_);
+  latencies_.push_back(latency_ms);
+  pthread_mutex_unlock(&mutex_);
+}
+
+int64 LatencyStats::count() const {
+  pthread_mutex_lock(&mutex_);
+  int64 count = latencies_.size();
+  pthread_mutex_unlock(&mutex_);
+  return count;
+}
+
+double LatencyStats::Percentile(double p) const {
+  CHECK_LT(0, p);
+  CHECK_LE(p, 100);
+  pthread_mutex_lock(&mutex_);
+  vector<double> sorted(latencies_);
+  pthread_mutex_unlock(&mutex_);
+  if (sorted.empty()) {
+    return 0;
+  }
+  // Nearest-rank percentile.
+  int rank = static_cast<int>(p / 100 * sorted.size() + 0.999999) - 1;
+  if (rank < 0) rank = 0;
+  if (rank >= sorted.size()) rank = sorted.size() - 1;
+  std::nth_element(sorted.begin(), sorted.begin() + rank, sorted.end());
+  return sorted[rank];
+}
+
+void LatencyStats::AppendAsString(std::ostream& out) const {
+  pthread_mutex_lock(&mutex_);
+  vector<double> latencies(latencies_);
+  pthread_mutex_unlock(&mutex_);
+  double sum = 0;
+  double max = 0;
+  for (int i = 0; i < latencies.size(); ++i) {
+    sum += latencies[i];
+    max = std::max(max, latencies[i]);
+  }
+  out << "requests: " << latencies.size()
+      << " mean_ms: " << (latencies.empty() ? 0 : sum / latencies.size())
+      << " p50_ms: " << Percentile(50)
+      << " p90_ms: " << Percentile(90)
+      << " p99_ms: " << Percentile(99)
+      << " max_ms: " << max;
+}
+
+}  // namespace learning_lda
@@ -0,0 +1,54 @@
+// Copyright 2008 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef _OPENSOURCE_GLDA_LATENCY_STATS_H__
+#define _OPENSOURCE_GLDA_LATENCY_STATS_H__
+
+#include <pthread.h>
+
+#include <iostream>
+#include <vector>
+
+#include "common.h"
+
+namespace learning_lda {
+
+// LatencyStats collects per-request latencies and reports their
+// percentiles.  It is thread-safe.
+class LatencyStats {
+ public:
+  LatencyStats();
+  ~LatencyStats();
+
+  // Records the latency of one request, in milliseconds.
+  void Add(double latency_ms);
+
+  // Returns the number of recorded requests.
+  int64 count() const;
+
+  // Returns the p-th percentile, 0 < p <= 100, of the recorded
+  // latencies, or 0 if nothing has been recorded.
+  double Percentile(double p) const;
+
+  // Output count, mean, p50, p90, p99 and max latencies in one line.
+  void AppendAsString(std::ostream& out) const;
+
+ private:
+  mutable pthread_mutex_t mutex_;
+  vector<double> latencies_;
+};
+
+}  // namespace learning_lda
+
+#endif  // _OPENSOURCE_GLDA_LATENCY_STATS_H__
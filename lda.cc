@@ -22,6 +22,12 @@
   --model_file /tmp/lda_model.txt                       \
   --burn_in_iterations 100                              \
   --total_iterations 150
+
+  If --init_model_file is given, the topics of the documents are
+  initialized by inference against that model instead of randomly.
+
+  If --out_of_core_file is given, the corpus and its topics are kept in
+  that file instead of memory and swept in blocks of --block_bytes.
 */
 
 #include <fstream>
@@ -34,7 +40,9 @@
 #include "document.h"
 #include "model.h"
 #include "accumulative_model.h"
+#include "out_of_core_corpus.h"
 #include "sampler.h"
+#include "vocabulary.h"
 #include "cmd_flags.h"
 
 namespace learning_lda {
@@ -45,12 +53,14 @@ using std::istringstream;
 using std::set;
 using std::map;
 
+// Loads corpus_file with random topics, with its words mapped by
+// vocabulary_filter.  Words not in word_index_map are added to it.
 int LoadAndInitTrainingCorpus(const string& corpus_file,
                               int num_topics,
+                              const VocabularyFilter& vocabulary_filter,
                               LDACorpus* corpus,
                               map<string, int>* word_index_map) {
   corpus->clear();
-  word_index_map->clear();
   ifstream fin(corpus_file.c_str());
   string line;
   while (getline(fin, line)) {  // Each line is a training document.
@@ -61,21 +71,26 @@ int LoadAndInitTrainingCorpus(const string& corpus_file,
       istringstream ss(line);
       DocumentWordTopicsPB document;
       string word;
+      string model_word;
       int count;
       while (ss >> word >> count) {  // Load and init a document.
+        if (!vocabulary_filter.Map(word, &model_word)) {
+          continue;
+        }
         vector<int32> topics;
         for (int i = 0; i < count; ++i) {
           topics.push_back(RandInt(num_topics));
         }
         int word_index;
-        map<string, int>::const_iterator iter = word_index_map->find(word);
+        map<string, int>::const_iterator iter =
+            word_index_map->find(model_word);
         if (iter == word_index_map->end()) {
           word_index = word_index_map->size();
-          (*word_index_map)[word] = word_index;
+          (*word_index_map)[model_word] = word_index;
         } else {
           word_index = iter->second;
         }
-        document.add_wordtopics(word, word_index, topics);
+        document.add_wordtopics(model_word, word_index, topics);
       }
       corpus->push_back(new LDADocument(document, num_topics));
     }
@@ -94,6 +109,88 @@ void FreeCorpus(LDACorpus* corpus) {
   }
 }
 
+// The number of Gibbs sampling iterations with which WarmStart infers
+// the topics of the documents.
+const int kWarmStartIterations = 3;
+
+// Reassigns the topics of the documents in corpus by sampling them
+// against init_model, whose words come first in word_index_map, without
+// changing the model.  Words unseen by init_model get zero counts.
+void WarmStart(const LDAModel& init_model,
+               const map<string, int>& word_index_map,
+               double alpha, double beta,
+               LDACorpus* corpus) {
+  LDAModel warm_model(init_model.num_topics(), word_index_map);
+  for (LDAModel::Iterator iter(&init_model); !iter.Done(); iter.Next()) {
+    for (int k = 0; k < init_model.num_topics(); ++k) {
+      warm_model.IncrementTopic(iter.Word(), k, iter.Distribution()[k]);
+    }
+  }
+  LDASampler sampler(alpha, beta, &warm_model, NULL);
+  for (int iter = 0; iter < kWarmStartIterations; ++iter) {
+    sampler.DoIteration(corpus, false, true);
+  }
+}
+
+// Trains a model like main with the corpus kept in an OutOfCoreCorpus.
+// The log likelihood of a block is computed right before the block is
+// sampled, and the model is accumulated once per sweep.
+int TrainOutOfCore(const LDACmdLineFlags& flags,
+                   const VocabularyFilter& vocabulary_filter) {
+  map<string, int> word_index_map;
+  OutOfCoreCorpus corpus(flags.training_data_file_, flags.out_of_core_file_,
+                         flags.num_topics_, flags.block_bytes_,
+                         vocabulary_filter, &word_index_map);
+  CHECK_GT(corpus.num_documents(), 0);
+  std::cout << corpus.num_documents() << " documents in "
+            << corpus.num_blocks() << " blocks of " << corpus.file_size()
+            << " bytes in total" << std::endl;
+  LDAModel model(flags.num_topics_, word_index_map);
+  LDAAccumulativeModel accum_model(flags.num_topics_, word_index_map.size());
+  LDASampler sampler(flags.alpha_, flags.beta_, &model, NULL);
+
+  corpus.StartSweep();
+  for (LDACorpus* block = corpus.NextBlock(); block != NULL;
+       block = corpus.NextBlock()) {
+    sampler.InitModelGivenTopics(*block);
+  }
+
+  for (int iter = 0; iter < flags.total_iterations_; ++iter) {
+    std::cout << "Iteration " << iter << " ...\n";
+    double loglikelihood = 0;
+    double sampling_time = 0;
+    corpus.StartSweep();
+    for (LDACorpus* block = corpus.NextBlock(); block != NULL;
+         block = corpus.NextBlock()) {
+      if (flags.compute_likelihood_ == "true") {
+        for (list<LDADocument*>::const_iterator iterator = block->begin();
+             iterator != block->end();
+             ++iterator) {
+          loglikelihood += sampler.LogLikelihood(*iterator);
+        }
+      }
+      double start = WallTime();
+      sampler.DoIteration(block, true, true);
+      sampling_time += WallTime() - start;
+    }
+    if (flags.compute_likelihood_ == "true") {
+      std::cout << "Loglikelihood: " << loglikelihood << std::endl;
+    }
+    std::cout << "Sampling " << sampling_time << " seconds, waiting for "
+              << "I/O " << corpus.io_wait_time() << " seconds" << std::endl;
+    if (iter >= flags.burn_in_iterations_) {
+      accum_model.AccumulateModel(model);
+    }
+  }
+  accum_model.AverageModel(
+      flags.total_iterations_ - flags.burn_in_iterations_);
+
+  std::ofstream fout(flags.model_file_.c_str());
+  vocabulary_filter.AppendAsString(fout);
+  accum_model.AppendAsString(word_index_map, fout);
+  return 0;
+}
+
 }  // namespace learning_lda
 
 int main(int argc, char** argv) {
@@ -103,6 +200,9 @@ int main(int argc, char** argv) {
   using learning_lda::LDASampler;
   using learning_lda::LDADocument;
   using learning_lda::LoadAndInitTrainingCorpus;
+  using learning_lda::WarmStart;
+  using learning_lda::WallTime;
+  using learning_lda::VocabularyFilter;
   using learning_lda::LDACmdLineFlags;
   using std::list;
 
@@ -112,17 +212,61 @@ int main(int argc, char** argv) {
     return -1;
   }
   srand(time(NULL));
+  double start = WallTime();
+  VocabularyFilter vocabulary_filter(flags);
+  if (vocabulary_filter.active()) {
+    std::cout << "Pruned " << vocabulary_filter.num_pruned_words()
+              << " words and hashed into "
+              << vocabulary_filter.num_hash_buckets() << " buckets in "
+              << WallTime() - start << " seconds" << std::endl;
+  }
+  if (!flags.out_of_core_file_.empty()) {
+    return learning_lda::TrainOutOfCore(flags, vocabulary_filter);
+  }
   LDACorpus corpus;
   map<string, int> word_index_map;
+  LDAModel* init_model = NULL;
+  if (!flags.init_model_file_.empty()) {
+    std::ifstream init_model_fin(flags.init_model_file_.c_str());
+    // The words of the corpus must be mapped to the words of init_model.
+    VocabularyFilter init_vocabulary_filter;
+    init_vocabulary_filter.ReadHeader(init_model_fin);
+    if (init_vocabulary_filter.num_hash_buckets() !=
+        vocabulary_filter.num_hash_buckets()) {
+      std::cerr << "init_model_file has num_hash_buckets "
+                << init_vocabulary_filter.num_hash_buckets()
+                << ", but num_hash_buckets is "
+                << vocabulary_filter.num_hash_buckets() << ".\n";
+      return -1;
+    }
+    init_model = new LDAModel(init_model_fin, &word_index_map);
+    if (init_model->num_topics() != flags.num_topics_) {
+      std::cerr << "init_model_file has " << init_model->num_topics()
+                << " topics, but num_topics is " << flags.num_topics_
+                << ".\n";
+      delete init_model;
+      return -1;
+    }
+  }
   CHECK_GT(LoadAndInitTrainingCorpus(flags.training_data_file_,
-                                     flags.num_topics_,
+                                     flags.num_topics_, vocabulary_filter,
                                      &corpus, &word_index_map), 0);
+  if (init_model != NULL) {
+    start = WallTime();
+    WarmStart(*init_model, word_index_map, flags.alpha_, flags.beta_,
+              &corpus);
+    std::cout << "Warm started from " << init_model->num_words()
+              << " words of " << word_index_map.size() << " in "
+              << WallTime() - start << " seconds" << std::endl;
+    delete init_model;
+  }
   LDAModel model(flags.num_topics_, word_index_map);
   LDAAccumulativeModel accum_model(flags.num_topics_, word_index_map.size());
   LDASampler sampler(flags.alpha_, flags.beta_, &model, &accum_model);
 
   sampler.InitModelGivenTopics(corpus);
 
+  bool target_reached = false;
   for (int iter = 0; iter < flags.total_iterations_; ++iter) {
     std::cout << "Iteration " << iter << " ...\n";
     if (flags.compute_likelihood_ == "true") {
@@ -133,6 +277,12 @@ int main(int argc, char** argv) {
         loglikelihood += sampler.LogLikelihood(*iterator);
       }
       std::cout << "Loglikelihood: " << loglikelihood << std::endl;
+      if (flags.target_loglikelihood_ < 0 && !target_reached &&
+          loglikelihood >= flags.target_loglikelihood_) {
+        std::cout << "Reached target_loglikelihood at iteration " << iter
+                  << std::endl;
+        target_reached = true;
+      }
     }
     sampler.DoIteration(&corpus, true, iter < flags.burn_in_iterations_);
   }
@@ -142,6 +292,7 @@ int main(int argc, char** argv) {
   FreeCorpus(&corpus);
 
   std::ofstream fout(flags.model_file_.c_str());
+  vocabulary_filter.AppendAsString(fout);
   accum_model.AppendAsString(word_index_map, fout);
 
   return 0;
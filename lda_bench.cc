@@ -0,0 +1,240 @@
+// Copyright 2008 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+/*
+  Microbenchmarks of the sampler kernels and data structures.  An
+  example running of this program:
+
+  ./lda_bench --max_model_mb 256
+
+  Every benchmark runs on models of 10 to 10000 topics and 1000 to
+  1000000 words, skipping those whose counts take more than
+  max_model_mb megabytes, with counts from a synthetic corpus whose word
+  frequencies follow a power law.  The corpus is drawn with the random
+  seed given by --seed (default 1), so that runs are comparable; it is
+  printed as a "#seed" line before the header.  A benchmark is repeated
+  for at least 0.2 seconds.  One tab-separated line is printed per
+  benchmark and model size: the benchmark, the number of processes
+  (always 1), the number of topics, the number of words, the unit of
+  work, the nanoseconds per unit and the units per second.  "make bench"
+  runs it together with allreduce_bench.
+*/
+
+#include <math.h>
+
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "common.h"
+#include "document.h"
+#include "model.h"
+#include "sampler.h"
+#include "cmd_flags.h"
+
+namespace learning_lda {
+
+const int kTopicSizes[] = { 10, 100, 1000, 10000 };
+const int kWordSizes[] = { 1000, 10000, 100000, 1000000 };
+const int kNumDocuments = 1000;
+const int kDocumentLength = 100;
+const int kNumIncrements = 1000000;
+const double kMinSeconds = 0.2;
+
+// Keeps the results of the benchmarks from being optimized away.
+volatile int64 sink = 0;
+
+struct BenchmarkContext {
+  int num_topics;
+  int num_words;
+  LDAModel* model;
+  LDASampler* sampler;
+  LDACorpus corpus;
+  // Random cells for IncrementTopic.
+  vector<int> increment_words;
+  vector<int> increment_topics;
+  // The model saved by SaveModel, for LoadModel.
+  string saved_model;
+};
+
+// A benchmark runs once over its input and returns the units of work
+// done.
+typedef int64 (*Benchmark)(BenchmarkContext* context);
+
+// Returns a word whose probability is about proportional to 1 / (word +
+// 1), like the words of natural language.
+int PowerLawWord(int num_words) {
+  int word = static_cast<int>(pow(num_words + 1.0, RandDouble())) - 1;
+  return word < num_words ? word : num_words - 1;
+}
+
+int64 SampleKernel(BenchmarkContext* context) {
+  vector<double> distribution;
+  int64 tokens = 0;
+  for (LDACorpus::iterator iter = context->corpus.begin();
+       iter != context->corpus.end(); ++iter) {
+    for (LDADocument::WordOccurrenceIterator iterator(*iter);
+         !iterator.Done(); iterator.Next()) {
+      context->sampler->GenerateTopicDistributionForWord(
+          **iter, iterator.Word(), iterator.Topic(), true, &distribution);
+      sink += GetAccumulativeSample(distribution);
+      ++tokens;
+    }
+  }
+  return tokens;
+}
+
+int64 IncrementTopic(BenchmarkContext* context) {
+  const vector<int>& words = context->increment_words;
+  const vector<int>& topics = context->increment_topics;
+  for (int i = 0; i < words.size(); ++i) {
+    context->model->IncrementTopic(words[i], topics[i], 1);
+  }
+  for (int i = 0; i < words.size(); ++i) {
+    context->model->IncrementTopic(words[i], topics[i], -1);
+  }
+  return 2 * static_cast<int64>(words.size());
+}
+
+int64 IterateWordOccurrences(BenchmarkContext* context) {
+  int64 tokens = 0;
+  for (LDACorpus::iterator iter = context->corpus.begin();
+       iter != context->corpus.end(); ++iter) {
+    for (LDADocument::WordOccurrenceIterator iterator(*iter);
+         !iterator.Done(); iterator.Next()) {
+      sink += iterator.Word() + iterator.Topic();
+      ++tokens;
+    }
+  }
+  return tokens;
+}
+
+int64 LogLikelihood(BenchmarkContext* context) {
+  double loglikelihood = 0;
+  for (LDACorpus::iterator iter = context->corpus.begin();
+       iter != context->corpus.end(); ++iter) {
+    loglikelihood += context->sampler->LogLikelihood(*iter);
+  }
+  sink += static_cast<int64>(loglikelihood);
+  return static_cast<int64>(kNumDocuments) * kDocumentLength;
+}
+
+int64 SaveModel(BenchmarkContext* context) {
+  std::ostringstream out;
+  context->model->AppendAsString(out);
+  context->saved_model = out.str();
+  return context->num_words;
+}
+
+int64 LoadModel(BenchmarkContext* context) {
+  std::istringstream in(context->saved_model);
+  map<string, int> word_index_map;
+  LDAModel model(in, &word_index_map);
+  sink += model.num_words();
+  return context->num_words;
+}
+
+// Runs benchmark for at least kMinSeconds and prints its line.
+void RunBenchmark(const char* name, const char* unit, Benchmark benchmark,
+                  BenchmarkContext* context) {
+  int64 units = 0;
+  double start = WallTime();
+  double elapsed;
+  do {
+    units += benchmark(context);
+    elapsed = WallTime() - start;
+  } while (elapsed < kMinSeconds);
+  std::cout << name << "\t1\t" << context->num_topics << "\t"
+            << context->num_words << "\t" << unit << "\t"
+            << elapsed * 1e9 / units << "\t" << units / elapsed << std::endl;
+}
+
+void RunBenchmarks(int num_topics, int num_words) {
+  BenchmarkContext context;
+  context.num_topics = num_topics;
+  context.num_words = num_words;
+  map<string, int> word_index_map;
+  for (int i = 0; i < num_words; ++i) {
+    std::ostringstream word;
+    word << "w" << i;
+    word_index_map[word.str()] = i;
+  }
+  for (int d = 0; d < kNumDocuments; ++d) {
+    // Occurrences of the same word are grouped as in the training data.
+    std::map<int, vector<int32> > word_topics;
+    for (int i = 0; i < kDocumentLength; ++i) {
+      word_topics[PowerLawWord(num_words)].push_back(RandInt(num_topics));
+    }
+    DocumentWordTopicsPB document;
+    for (std::map<int, vector<int32> >::const_iterator iter =
+             word_topics.begin(); iter != word_topics.end(); ++iter) {
+      std::ostringstream word;
+      word << "w" << iter->first;
+      document.add_wordtopics(word.str(), iter->first, iter->second);
+    }
+    context.corpus.push_back(new LDADocument(document, num_topics));
+  }
+  for (int i = 0; i < kNumIncrements; ++i) {
+    context.increment_words.push_back(PowerLawWord(num_words));
+    context.increment_topics.push_back(RandInt(num_topics));
+  }
+  context.model = new LDAModel(num_topics, word_index_map);
+  context.sampler = new LDASampler(0.1, 0.01, context.model, NULL);
+  context.sampler->InitModelGivenTopics(context.corpus);
+
+  RunBenchmark("SampleKernel", "token", SampleKernel, &context);
+  RunBenchmark("IncrementTopic", "op", IncrementTopic, &context);
+  RunBenchmark("WordOccurrenceIterator", "token", IterateWordOccurrences,
+               &context);
+  RunBenchmark("LogLikelihood", "token", LogLikelihood, &context);
+  RunBenchmark("SaveModel", "word", SaveModel, &context);
+  RunBenchmark("LoadModel", "word", LoadModel, &context);
+
+  delete context.sampler;
+  delete context.model;
+  for (LDACorpus::iterator iter = context.corpus.begin();
+       iter != context.corpus.end(); ++iter) {
+    delete *iter;
+  }
+}
+
+}  // namespace learning_lda
+
+int main(int argc, char** argv) {
+  using learning_lda::LDACmdLineFlags;
+
+  LDACmdLineFlags flags;
+  flags.ParseCmdFlags(argc, argv);
+  if (!flags.CheckBenchmarkValidity()) {
+    return -1;
+  }
+  // A fixed seed, so that every run benchmarks the same corpus.
+  srand(flags.seed_);
+  std::cout << "#seed\t" << flags.seed_ << "\n";
+  std::cout << "benchmark\tprocesses\tnum_topics\tnum_words\tunit\t"
+            << "ns_per_unit\tunits_per_second" << std::endl;
+  const int64 max_model_bytes = static_cast<int64>(flags.max_model_mb_) << 20;
+  for (int k = 0; k < sizeof(learning_lda::kTopicSizes) / sizeof(int); ++k) {
+    for (int v = 0; v < sizeof(learning_lda::kWordSizes) / sizeof(int); ++v) {
+      const int num_topics = learning_lda::kTopicSizes[k];
+      const int num_words = learning_lda::kWordSizes[v];
+      if (static_cast<int64>(num_topics) * (num_words + 1) * sizeof(int64) <=
+          max_model_bytes) {
+        learning_lda::RunBenchmarks(num_topics, num_words);
+      }
+    }
+  }
+  return 0;
+}
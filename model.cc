@@ -14,9 +14,13 @@
 
 #include "model.h"
 
+#include <algorithm>
 #include <map>
 #include <sstream>
 #include <string>
+#include <utility>
+
+#include "numa_placement.h"
 
 namespace learning_lda {
 
@@ -50,20 +54,38 @@ const TopicCountDistribution& LDAModel::Iterator::Distribution() const {
 
 LDAModel::LDAModel(
     int num_topics, const map<string, int>& word_index_map) {
-  int vocab_size = word_index_map.size();
-  memory_alloc_.resize(((int64)(num_topics)) * ((int64) vocab_size + 1), 0);
+  Initialize(num_topics, word_index_map.size());
+  word_index_map_ = word_index_map;
+}
+
+LDAModel::LDAModel(int num_topics, int num_words) {
+  Initialize(num_topics, num_words);
+}
+
+void LDAModel::Initialize(int num_topics, int vocab_size) {
+  int64 size = ((int64)(num_topics)) * ((int64) vocab_size + 1);
+  // Reserved first, so that huge pages are asked for before the counts
+  // are touched.
+  memory_alloc_.reserve(size);
+  AdviseHugePages(memory_alloc_.data(), size * sizeof(int64));
+  memory_alloc_.resize(size, 0);
+  Initialize(num_topics, vocab_size, &memory_alloc_[0]);
+}
+
+void LDAModel::Initialize(int num_topics, int vocab_size, int64* memory) {
+  concurrent_ = false;
+  memory_ = memory;
+  memory_size_ = ((int64)(num_topics)) * ((int64) vocab_size + 1);
   // topic_distribution and global_distribution are just accessor pointers
   // and are not responsible for allocating/deleting memory.
   topic_distributions_.resize(vocab_size);
   global_distribution_.Reset(
-      &memory_alloc_[0] + (int64)vocab_size * num_topics,
+      memory + (int64)vocab_size * num_topics,
       num_topics);
   for (int i = 0; i < vocab_size; ++i) {
     topic_distributions_[i] =
-        TopicCountDistribution(&memory_alloc_[0] + num_topics * i,
-                               num_topics);
+        TopicCountDistribution(memory + (int64)num_topics * i, num_topics);
   }
-  word_index_map_ = word_index_map;
 }
 
 const TopicCountDistribution& LDAModel::GetWordTopicDistribution(
@@ -82,6 +104,13 @@ void LDAModel::IncrementTopic(int word,
   CHECK_GT(num_topics(), topic);
   CHECK_GT(num_words(), word);
 
+  if (concurrent_) {
+    int64 new_count =
+        __sync_add_and_fetch(&topic_distributions_[word][topic], count);
+    __sync_add_and_fetch(&global_distribution_[topic], count);
+    CHECK_LE(0, new_count);
+    return;
+  }
   topic_distributions_[word][topic] += count;
   global_distribution_[topic] += count;
   CHECK_LE(0, topic_distributions_[word][topic]);
@@ -95,14 +124,31 @@ void LDAModel::ReassignTopic(int word,
   IncrementTopic(word, new_topic, count);
 }
 
+void LDAModel::ApplyDelta(const LDAModelDelta& delta) {
+  CHECK_EQ(num_topics(), delta.num_topics());
+  const vector<int64>& cells = delta.cells();
+  const vector<int32>& counts = delta.counts();
+  for (int64 i = 0; i < cells.size(); ++i) {
+    memory_[cells[i]] += counts[i];
+    global_distribution_[cells[i] % num_topics()] += counts[i];
+  }
+}
+
 void LDAModel::AppendAsString(std::ostream& out) const {
+  CHECK_EQ(num_words(), word_index_map_.size());
   vector<string> index_word_map(word_index_map_.size());
   for (map<string, int>::const_iterator iter = word_index_map_.begin();
        iter != word_index_map_.end(); ++iter) {
     index_word_map[iter->second] = iter->first;
   }
+  AppendAsString(index_word_map, out);
+}
+
+void LDAModel::AppendAsString(const vector<string>& words,
+                              std::ostream& out) const {
+  CHECK_EQ(num_words(), words.size());
   for (LDAModel::Iterator iter(this); !iter.Done(); iter.Next()) {
-    out << index_word_map[iter.Word()] << "\t";
+    out << words[iter.Word()] << "\t";
     for (int topic = 0; topic < num_topics(); ++topic) {
       out << iter.Distribution()[topic]
           << ((topic < num_topics() - 1) ? " " : "\n");
@@ -122,7 +168,7 @@ LDAModel::LDAModel(std::istream& in, map<string, int>* word_index_map) {
       std::istringstream ss(line);
       string word;
       double count_float;
-      CHECK(ss >> word);
+      CHECK(static_cast<bool>(ss >> word));
       while (ss >> count_float) {
         memory_alloc_.push_back((int64)count_float);
       }
@@ -133,17 +179,7 @@ LDAModel::LDAModel(std::istream& in, map<string, int>* word_index_map) {
   int vocab_size = word_index_map_.size();
   int num_topics = memory_alloc_.size() / vocab_size;
   memory_alloc_.resize(((int64)(num_topics)) * ((int64) vocab_size + 1), 0);
-  // topic_distribution and global_distribution are just accessor pointers
-  // and are not responsible for allocating/deleting memory.
-  topic_distributions_.resize(vocab_size);
-  global_distribution_.Reset(
-      &memory_alloc_[0] + (int64)vocab_size * num_topics,
-      num_topics);
-  for (int i = 0; i < vocab_size; ++i) {
-    topic_distributions_[i] =
-        TopicCountDistribution(&memory_alloc_[0] + num_topics * i,
-                               num_topics);
-  }
+  Initialize(num_topics, vocab_size, &memory_alloc_[0]);
   for (int i = 0; i < vocab_size; ++i) {
     for (int j = 0; j < num_topics; ++j) {
       global_distribution_[j] += topic_distributions_[i][j];
@@ -151,4 +187,53 @@ LDAModel::LDAModel(std::istream& in, map<string, int>* word_index_map) {
   }
   *word_index_map = word_index_map_;
 }
+
+void LDAModelDelta::Append(const LDAModelDelta& other) {
+  CHECK_EQ(num_topics_, other.num_topics());
+  cells_.insert(cells_.end(), other.cells().begin(), other.cells().end());
+  counts_.insert(counts_.end(), other.counts().begin(), other.counts().end());
+  if (cells_.size() >= compact_size_) {
+    Compact();
+  }
+}
+
+void LDAModelDelta::Compact() {
+  // Entries [0, sorted) are sorted by cell already, e.g., by the last
+  // Compact, so only the others are sorted before being merged in.
+  const int64 size = cells_.size();
+  int64 sorted = std::min(size, static_cast<int64>(1));
+  while (sorted < size && cells_[sorted - 1] < cells_[sorted]) {
+    ++sorted;
+  }
+  vector<std::pair<int64, int32> > entries(size - sorted);
+  for (int64 i = sorted; i < size; ++i) {
+    entries[i - sorted] = std::make_pair(cells_[i], counts_[i]);
+  }
+  std::sort(entries.begin(), entries.end());
+  // Merges from the back into the end of cells_ and counts_, which never
+  // overtakes the sorted entries not read yet.
+  int64 out = size;
+  int64 i = sorted - 1;
+  int64 j = static_cast<int64>(entries.size()) - 1;
+  while (i >= 0 || j >= 0) {
+    int64 cell = (j < 0 || (i >= 0 && cells_[i] > entries[j].first)) ?
+        cells_[i] : entries[j].first;
+    int64 count = 0;
+    for (; i >= 0 && cells_[i] == cell; --i) {
+      count += counts_[i];
+    }
+    for (; j >= 0 && entries[j].first == cell; --j) {
+      count += entries[j].second;
+    }
+    if (count != 0) {
+      --out;
+      cells_[out] = cell;
+      counts_[out] = count;
+    }
+  }
+  cells_.erase(cells_.begin(), cells_.begin() + out);
+  counts_.erase(counts_.begin(), counts_.begin() + out);
+  compact_size_ = std::max(static_cast<int64>(kMinCompactSize),
+                           2 * static_cast<int64>(cells_.size()));
+}
 }  // namespace learning_lda
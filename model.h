@@ -24,6 +24,8 @@
 
 namespace learning_lda {
 
+class LDAModelDelta;
+
 // The LDAModel class stores topic-word co-occurrence count vectors as
 // well as a vector of global topic occurrence counts.  The global vector is
 // the sum of the other vectors.  These vectors are precisely the components of
@@ -34,7 +36,8 @@ namespace learning_lda {
 // word occurrences from one topic to another.
 //
 // This class is not thread-safe.  Do not share an object of this
-// class by multiple threads.
+// class by multiple threads, except for sampling after
+// set_concurrent(true).
 class LDAModel {
  public:
   // An iterator over a LDAModel.  Returns distributions in an arbitrary
@@ -68,6 +71,11 @@ class LDAModel {
 
   LDAModel(int num_topic, const map<string, int>& word_index_map);
 
+  // Creates a zero model of num_words words without their strings, for
+  // processes that do not hold the whole vocabulary.  Such a model can
+  // only be written by the AppendAsString that takes the words.
+  LDAModel(int num_topic, int num_words);
+
   // Read word topic distribution and global distribution from iframe.
   // Return a map from word string to index. Intenally we use int to represent
   // each word.
@@ -95,6 +103,16 @@ class LDAModel {
                      int new_topic,
                      int64 count);
 
+  // If concurrent is true, IncrementTopic and ReassignTopic may be
+  // called by several threads at the same time; counts are then changed
+  // by atomic additions, while readers may see counts that other threads
+  // are about to change.
+  void set_concurrent(bool concurrent) { concurrent_ = concurrent; }
+
+  // Adds the changes recorded in delta to the word topic distributions
+  // and to the global distribution.
+  void ApplyDelta(const LDAModelDelta& delta);
+
   // Returns the number of topics in the model.
   int num_topics() const { return global_distribution_.size(); }
 
@@ -104,10 +122,31 @@ class LDAModel {
   // Output topic_distributions_ into human readable format.
   void AppendAsString(std::ostream& out) const;
 
+  // The same, with words[i] the string of word i.
+  void AppendAsString(const vector<string>& words, std::ostream& out) const;
+
 
  protected:
+  // Creates a model without counts, which a subclass must give by
+  // Initialize.
+  LDAModel() {}
+
+  // Allocates the zero counts of num_words words.
+  void Initialize(int num_topics, int num_words);
+
+  // Uses the num_topics * (num_words + 1) counts at memory, the rows of
+  // the words followed by the global topic counts, which are not
+  // cleared.  memory is owned by the caller, e.g., shared with other
+  // processes, and must outlive the model.
+  void Initialize(int num_topics, int num_words, int64* memory);
+
   // The dataset which keep all the model memory.
   vector<int64> memory_alloc_;
+
+  // The counts in use, memory_alloc_ unless given by Initialize, and
+  // their number.
+  int64* memory_;
+  int64 memory_size_;
  private:
   // If users query a word for its topic distribution via
   // GetWordTopicDistribution, but this word does not appear in the
@@ -125,6 +164,66 @@ class LDAModel {
   TopicCountDistribution global_distribution_;
 
   map<string, int> word_index_map_;
+
+  bool concurrent_;
+};
+
+// LDAModelDelta records changes of the word topic counts of an LDAModel
+// as (cell, count) entries, where cell = word * num_topics + topic is
+// the offset of the count in the model memory.  Distributed trainers use
+// it to exchange only the counts that changed since the last
+// synchronization.
+//
+// A delta compacts itself whenever Add or Append doubled its size since
+// the last Compact, so that its memory grows with the number of cells
+// changed rather than with the number of changes.  Entries compacted
+// before are kept in place if every entry added since has a larger cell.
+class LDAModelDelta {
+ public:
+  explicit LDAModelDelta(int num_topics)
+      : num_topics_(num_topics), compact_size_(kMinCompactSize) {}
+  ~LDAModelDelta() {}
+
+  // Records that the count of word and topic changed by count.
+  void Add(int word, int topic, int64 count) {
+    cells_.push_back(static_cast<int64>(word) * num_topics_ + topic);
+    counts_.push_back(count);
+    if (cells_.size() >= compact_size_) {
+      Compact();
+    }
+  }
+
+  // Records the changes of other.
+  void Append(const LDAModelDelta& other);
+
+  // Sorts the entries by cell, merges entries of the same cell and drops
+  // entries whose count sums up to zero.
+  void Compact();
+
+  void clear() {
+    cells_.clear();
+    counts_.clear();
+    compact_size_ = kMinCompactSize;
+  }
+
+  int64 size() const { return cells_.size(); }
+  int num_topics() const { return num_topics_; }
+  const vector<int64>& cells() const { return cells_; }
+  const vector<int32>& counts() const { return counts_; }
+  vector<int64>* mutable_cells() { return &cells_; }
+  vector<int32>* mutable_counts() { return &counts_; }
+
+ private:
+  // The size below which a delta is never compacted automatically.
+  enum { kMinCompactSize = 1 << 20 };
+
+  int num_topics_;
+  vector<int64> cells_;
+  // The change of a count between two synchronizations is bounded by the
+  // number of word occurrences held by one process.
+  vector<int32> counts_;
+  // The size at which Add and Append compact.
+  int64 compact_size_;
 };
 
 }  // namespace learning_lda
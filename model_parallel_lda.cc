@@ -0,0 +1,237 @@
+// Copyright 2008 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "model_parallel_lda.h"
+
+#include <limits.h>
+#include <math.h>
+
+#include <algorithm>
+
+namespace learning_lda {
+
+ModelParallelLDA::ModelParallelLDA(int num_topics, double alpha, double beta,
+                                   int num_words, LDACorpus* corpus)
+    : num_topics_(num_topics),
+      alpha_(alpha),
+      beta_(beta),
+      num_words_(num_words),
+      word_occurrences_(*corpus, num_words),
+      step_(0),
+      global_distribution_(num_topics, 0),
+      global_delta_(num_topics, 0),
+      sent_global_delta_(num_topics, 0),
+      reduced_global_delta_(num_topics, 0),
+      global_delta_request_(MPI_REQUEST_NULL),
+      loglikelihood_(0) {
+  MPI_Comm_rank(MPI_COMM_WORLD, &myid_);
+  MPI_Comm_size(MPI_COMM_WORLD, &pnum_);
+  block_begin_.resize(num_blocks() + 1);
+  int max_block_size = 0;
+  for (int b = 0; b <= num_blocks(); ++b) {
+    block_begin_[b] = static_cast<int64>(num_words) * b / num_blocks();
+    if (b > 0) {
+      max_block_size = std::max(max_block_size, block_size(b - 1));
+    }
+  }
+  // A block is sent in one message.
+  CHECK_LT(static_cast<int64>(max_block_size) * num_topics, INT_MAX);
+  for (int i = 0; i < kNumBuffers; ++i) {
+    buffers_[i].resize(static_cast<int64>(max_block_size) * num_topics);
+    send_requests_[i] = MPI_REQUEST_NULL;
+    recv_requests_[i] = MPI_REQUEST_NULL;
+  }
+
+  // Process r starts with blocks 2r and 2r + 1, i.e., those of steps 0
+  // and 1.
+  vector<int64> local_counts(buffers_[0].size());
+  for (int b = 0; b < num_blocks(); ++b) {
+    std::fill(local_counts.begin(), local_counts.end(), 0);
+    for (int w = block_begin_[b]; w < block_begin_[b + 1]; ++w) {
+      int64* row = &local_counts[0] +
+          static_cast<int64>(w - block_begin_[b]) * num_topics;
+      for (int64 i = word_occurrences_.begin(w);
+           i < word_occurrences_.begin(w + 1); ++i) {
+        const DocumentWordTopicsPB& topics =
+            word_occurrences_.document(i)->topics();
+        int word_index = word_occurrences_.word_index(i);
+        for (int j = topics.word_last_topic_index(word_index) -
+                 topics.wordtopics_count(word_index) + 1;
+             j <= topics.word_last_topic_index(word_index); ++j) {
+          ++row[topics.wordtopics(j)];
+          ++global_distribution_[topics.wordtopics(j)];
+        }
+      }
+    }
+    int owner = b / 2;
+    MPI_Reduce(&local_counts[0],
+               owner == myid_ ? &buffers_[b % 2][0] : NULL,
+               block_size(b) * num_topics, MPI_LONG_LONG, MPI_SUM, owner,
+               MPI_COMM_WORLD);
+  }
+  MPI_Allreduce(MPI_IN_PLACE, &global_distribution_[0], num_topics,
+                MPI_LONG_LONG, MPI_SUM, MPI_COMM_WORLD);
+}
+
+void ModelParallelLDA::DoIteration(bool compute_likelihood) {
+  const int left = (myid_ + pnum_ - 1) % pnum_;
+  const int right = (myid_ + 1) % pnum_;
+  double loglikelihood_local = 0;
+  for (int i = 0; i < num_blocks(); ++i) {
+    int64 s = step_ + i;
+    int current = s % kNumBuffers;
+    int after_next = (s + 2) % kNumBuffers;
+    // The buffer of step s - 2, whose send had step s - 1 to complete, is
+    // reused for step s + 2.
+    MPI_Wait(&recv_requests_[current], MPI_STATUS_IGNORE);
+    MPI_Wait(&send_requests_[after_next], MPI_STATUS_IGNORE);
+    int after_next_block = (2 * myid_ + s + 2) % num_blocks();
+    MPI_Irecv(&buffers_[after_next][0],
+              block_size(after_next_block) * num_topics_, MPI_LONG_LONG,
+              right, 0, MPI_COMM_WORLD, &recv_requests_[after_next]);
+
+    int block = (2 * myid_ + s) % num_blocks();
+    SampleBlock(block, &buffers_[current][0],
+                compute_likelihood ? &loglikelihood_local : NULL);
+    MPI_Isend(&buffers_[current][0], block_size(block) * num_topics_,
+              MPI_LONG_LONG, left, 0, MPI_COMM_WORLD,
+              &send_requests_[current]);
+    FinishGlobalDistributionAllReduce();
+    StartGlobalDistributionAllReduce();
+  }
+  step_ += num_blocks();
+  FinishGlobalDistributionAllReduce();
+  // Process r holds blocks 2r and 2r + 1 again.
+  MPI_Waitall(kNumBuffers, recv_requests_, MPI_STATUSES_IGNORE);
+  MPI_Waitall(kNumBuffers, send_requests_, MPI_STATUSES_IGNORE);
+  if (compute_likelihood) {
+    MPI_Allreduce(&loglikelihood_local, &loglikelihood_, 1, MPI_DOUBLE,
+                  MPI_SUM, MPI_COMM_WORLD);
+  }
+}
+
+void ModelParallelLDA::SampleBlock(int block, int64* counts,
+                                   double* loglikelihood) {
+  const double words_beta = num_words_ * beta_;
+  vector<double> distribution(num_topics_);
+  for (int w = block_begin_[block]; w < block_begin_[block + 1]; ++w) {
+    int64* row = counts +
+        static_cast<int64>(w - block_begin_[block]) * num_topics_;
+    for (int64 i = word_occurrences_.begin(w);
+         i < word_occurrences_.begin(w + 1); ++i) {
+      LDADocument* document = word_occurrences_.document(i);
+      const DocumentWordTopicsPB& topics = document->topics();
+      const vector<int64>& document_distribution =
+          document->topic_distribution();
+      int word_index = word_occurrences_.word_index(i);
+      for (int j = topics.word_last_topic_index(word_index) -
+               topics.wordtopics_count(word_index) + 1;
+           j <= topics.word_last_topic_index(word_index); ++j) {
+        if (loglikelihood != NULL) {
+          // log P(w) = log sum_z P(w|z)P(z|d), as LDASampler computes.
+          double prob_word = 0;
+          double document_length = topics.wordtopics_size();
+          for (int k = 0; k < num_topics_; ++k) {
+            prob_word += (row[k] + beta_) /
+                (global_distribution_[k] + words_beta) *
+                (document_distribution[k] + alpha_) /
+                (document_length + alpha_ * num_topics_);
+          }
+          *loglikelihood += log(prob_word);
+        }
+        int old_topic = document->Topic(j);
+        for (int k = 0; k < num_topics_; ++k) {
+          int adjustment = k == old_topic ? -1 : 0;
+          distribution[k] =
+              (row[k] + adjustment + beta_) *
+              (document_distribution[k] + adjustment + alpha_) /
+              (global_distribution_[k] + adjustment + words_beta);
+        }
+        int new_topic = GetAccumulativeSample(distribution);
+        if (new_topic != old_topic) {
+          --row[old_topic];
+          ++row[new_topic];
+          --global_distribution_[old_topic];
+          ++global_distribution_[new_topic];
+          --global_delta_[old_topic];
+          ++global_delta_[new_topic];
+          document->SetTopic(j, new_topic);
+        }
+      }
+    }
+  }
+}
+
+void ModelParallelLDA::StartGlobalDistributionAllReduce() {
+  CHECK(global_delta_request_ == MPI_REQUEST_NULL);
+  sent_global_delta_.swap(global_delta_);
+  std::fill(global_delta_.begin(), global_delta_.end(), 0);
+  MPI_Iallreduce(&sent_global_delta_[0], &reduced_global_delta_[0],
+                 num_topics_, MPI_LONG_LONG, MPI_SUM, MPI_COMM_WORLD,
+                 &global_delta_request_);
+}
+
+void ModelParallelLDA::FinishGlobalDistributionAllReduce() {
+  if (global_delta_request_ == MPI_REQUEST_NULL) {
+    return;
+  }
+  MPI_Wait(&global_delta_request_, MPI_STATUS_IGNORE);
+  // Our own changes are already in global_distribution_.
+  for (int k = 0; k < num_topics_; ++k) {
+    global_distribution_[k] +=
+        reduced_global_delta_[k] - sent_global_delta_[k];
+  }
+}
+
+int64 ModelParallelLDA::model_memory() const {
+  int64 memory = 0;
+  for (int i = 0; i < kNumBuffers; ++i) {
+    memory += buffers_[i].size() * sizeof(int64);
+  }
+  return memory + 4 * num_topics_ * sizeof(int64);
+}
+
+void ModelParallelLDA::AppendAsString(const vector<string>& words,
+                                      std::ostream& out) const {
+  vector<int64> received(myid_ == 0 ? buffers_[0].size() : 0);
+  for (int b = 0; b < num_blocks(); ++b) {
+    // Block b is in buffers_[(step_ + b % 2) % 4] of process b / 2.
+    int owner = b / 2;
+    const int64* counts = &buffers_[(step_ + b % 2) % kNumBuffers][0];
+    int size = block_size(b) * num_topics_;
+    if (owner != 0) {
+      if (myid_ == owner) {
+        MPI_Send(const_cast<int64*>(counts), size, MPI_LONG_LONG, 0, 0,
+                 MPI_COMM_WORLD);
+      } else if (myid_ == 0) {
+        MPI_Recv(&received[0], size, MPI_LONG_LONG, owner, 0,
+                 MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+        counts = &received[0];
+      }
+    }
+    if (myid_ != 0) {
+      continue;
+    }
+    for (int w = block_begin_[b]; w < block_begin_[b + 1]; ++w) {
+      const int64* row =
+          counts + static_cast<int64>(w - block_begin_[b]) * num_topics_;
+      out << words[w] << "\t";
+      for (int k = 0; k < num_topics_; ++k) {
+        out << row[k] << ((k < num_topics_ - 1) ? " " : "\n");
+      }
+    }
+  }
+}
+
+}  // namespace learning_lda
@@ -0,0 +1,130 @@
+// Copyright 2008 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef _OPENSOURCE_GLDA_MODEL_PARALLEL_LDA_H__
+#define _OPENSOURCE_GLDA_MODEL_PARALLEL_LDA_H__
+
+#include "mpi.h"
+
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "common.h"
+#include "document.h"
+#include "parallel_model.h"
+
+namespace learning_lda {
+
+// ModelParallelLDA trains an LDA model whose word-topic counts are
+// partitioned by word across the MPI processes, as in PLDA+, so that no
+// process holds the whole model.
+//
+// The vocabulary is split into 2P contiguous word blocks, P being the
+// number of processes.  Between iterations process r holds blocks 2r
+// and 2r + 1.  An iteration takes 2P steps; at step s, process r samples
+// the occurrences of block (2r + s) mod 2P in its local documents, then
+// sends the block to process r - 1, which samples it two steps later.
+// The block for step s + 2 is received from process r + 1 while step s
+// is sampled, and the block of step s - 1 may still be being sent, so
+// communication overlaps with sampling, and every process holds at most
+// four blocks at a time.  The global topic counts are kept on every
+// process; the changes of every step are allreduced in the background
+// while the next step is sampled, and are complete at the end of the
+// iteration.
+class ModelParallelLDA {
+ public:
+  // Builds the initial counts of the word blocks from the topic
+  // assignments of the local corpus, whose words must be indexed in
+  // [0, num_words).  Collective.
+  ModelParallelLDA(int num_topics, double alpha, double beta, int num_words,
+                   LDACorpus* corpus);
+  ~ModelParallelLDA() {}
+
+  // Performs one Gibbs sampling iteration over the local corpus.  If
+  // compute_likelihood is true, the log likelihood of the corpora of all
+  // processes is computed on the way, each block right before it is
+  // sampled, and can be read from loglikelihood().  Collective.
+  void DoIteration(bool compute_likelihood);
+
+  double loglikelihood() const { return loglikelihood_; }
+
+  // Returns the number of bytes of word-topic and topic counts this
+  // process holds at most.
+  int64 model_memory() const;
+
+  // Returns the number of bytes of the whole word-topic counts.
+  int64 full_model_memory() const {
+    return static_cast<int64>(num_words_) * num_topics_ * sizeof(int64);
+  }
+
+  // Writes the model in the format of LDAModel::AppendAsString to out on
+  // process 0, which receives the blocks one at a time.  words[i] is the
+  // string of word i and is only needed on process 0.  Collective.
+  void AppendAsString(const vector<string>& words, std::ostream& out) const;
+
+ private:
+  int num_blocks() const { return 2 * pnum_; }
+  int block_size(int block) const {
+    return block_begin_[block + 1] - block_begin_[block];
+  }
+
+  // Samples the occurrences of block in the local corpus, whose counts
+  // are in counts, and adds the log likelihood of the occurrences before
+  // sampling to *loglikelihood if it is not NULL.
+  void SampleBlock(int block, int64* counts, double* loglikelihood);
+
+  // Starts allreducing the changes of the global topic counts made since
+  // the last call.
+  void StartGlobalDistributionAllReduce();
+
+  // Waits for the allreduce started last, if any, and adds the changes
+  // of the other processes to global_distribution_.
+  void FinishGlobalDistributionAllReduce();
+
+  const int num_topics_;
+  const double alpha_;
+  const double beta_;
+  const int num_words_;
+  int myid_;
+  int pnum_;
+
+  // Block b covers words [block_begin_[b], block_begin_[b + 1]).
+  vector<int> block_begin_;
+  WordOccurrenceIndex word_occurrences_;
+
+  enum { kNumBuffers = 4 };
+
+  // The blocks of steps s, s + 1 and s + 2 are in buffers_[s % 4],
+  // buffers_[(s + 1) % 4] and buffers_[(s + 2) % 4], and the block of
+  // step s - 1 is sent from buffers_[(s + 3) % 4].
+  vector<int64> buffers_[kNumBuffers];
+  MPI_Request send_requests_[kNumBuffers];
+  MPI_Request recv_requests_[kNumBuffers];
+  int64 step_;
+
+  vector<int64> global_distribution_;
+  // The changes of global_distribution_ not yet being allreduced.
+  vector<int64> global_delta_;
+  // The changes being allreduced, and their sum over all processes.
+  vector<int64> sent_global_delta_;
+  vector<int64> reduced_global_delta_;
+  MPI_Request global_delta_request_;
+  double loglikelihood_;
+};
+
+}  // namespace learning_lda
+
+#endif  // _OPENSOURCE_GLDA_MODEL_PARALLEL_LDA_H__
@@ -34,10 +34,18 @@
 #include <string>
 
 #include "common.h"
+#include "corpus_partition.h"
 #include "document.h"
 #include "model.h"
 #include "accumulative_model.h"
 #include "sampler.h"
+#include "threaded_sampler.h"
+#include "distributed_vocabulary.h"
+#include "model_parallel_lda.h"
+#include "mpi_parameter_server.h"
+#include "numa_placement.h"
+#include "parallel_model.h"
+#include "parameter_server.h"
 #include "cmd_flags.h"
 
 using std::ifstream;
@@ -47,116 +55,206 @@ using std::set;
 using std::vector;
 using std::list;
 using std::map;
-using std::sort;
 using std::string;
 using learning_lda::LDADocument;
 
 namespace learning_lda {
 
-// A wrapper of MPI_Allreduce. If the vector is over 32M, we allreduce part
-// after part. This will save temporary memory needed.
-void AllReduceTopicDistribution(int64* buf, int count) {
-  static int kMaxDataCount = 1 << 22;
-  static int datatype_size = sizeof(*buf);
-  if (count > kMaxDataCount) {
-    char* tmp_buf = new char[datatype_size * kMaxDataCount];
-    for (int i = 0; i < count / kMaxDataCount; ++i) {
-      MPI_Allreduce(reinterpret_cast<char*>(buf) +
-             datatype_size * kMaxDataCount * i,
-             tmp_buf,
-             kMaxDataCount, MPI_LONG_LONG, MPI_SUM, MPI_COMM_WORLD);
-      memcpy(reinterpret_cast<char*>(buf) +
-             datatype_size * kMaxDataCount * i, tmp_buf,
-             kMaxDataCount * datatype_size);
-    }
-    // If count is not divisible by kMaxDataCount, there are some elements left
-    // to be reduced.
-    if (count % kMaxDataCount > 0) {
-      MPI_Allreduce(reinterpret_cast<char*>(buf)
-               + datatype_size * kMaxDataCount * (count / kMaxDataCount),
-               tmp_buf,
-               count - kMaxDataCount * (count / kMaxDataCount), MPI_LONG_LONG, MPI_SUM,
-               MPI_COMM_WORLD);
-      memcpy(reinterpret_cast<char*>(buf)
-               + datatype_size * kMaxDataCount * (count / kMaxDataCount),
-               tmp_buf,
-               (count - kMaxDataCount * (count / kMaxDataCount)) * datatype_size);
-    }
-    delete[] tmp_buf;
+// Reads the document lines in byte range part of num_parts equal byte
+// ranges of corpus_file.  A document belongs to the range holding its
+// first byte, so a process skips the rest of a document that starts
+// before its range and reads on past the end of its range to finish its
+// last document.  Nothing is read if part < 0.
+void ReadCorpusRange(const string& corpus_file, int part, int num_parts,
+                     vector<string>* lines) {
+  lines->clear();
+  if (part < 0) {
+    return;
+  }
+  ifstream fin(corpus_file.c_str(), std::ios::binary);
+  CHECK(static_cast<bool>(fin));
+  fin.seekg(0, std::ios::end);
+  int64 size = fin.tellg();
+  int64 begin = size * part / num_parts;
+  int64 end = size * (part + 1) / num_parts;
+  int64 position = begin;
+  string line;
+  if (begin > 0) {
+    // Skips up to the first line starting at or after begin.
+    fin.seekg(begin - 1);
+    getline(fin, line);
+    position += line.size();
   } else {
-    char* tmp_buf = new char[datatype_size * count];
-    MPI_Allreduce(buf, tmp_buf, count, MPI_LONG_LONG, MPI_SUM, MPI_COMM_WORLD);
-    memcpy(buf, tmp_buf, datatype_size * count);
-    delete[] tmp_buf;
+    fin.seekg(0);
+  }
+  while (position < end && getline(fin, line)) {
+    position += line.size() + 1;
+    if (line.size() > 0 &&      // Skip empty lines.
+        line[0] != '\r' &&      // Skip empty lines.
+        line[0] != '\n' &&      // Skip empty lines.
+        line[0] != '#') {       // Skip comment lines.
+      lines->push_back(line);
+    }
   }
 }
 
-class ParallelLDAModel : public LDAModel {
- public:
-  ParallelLDAModel(int num_topic, const map<string, int>& word_index_map)
-      : LDAModel(num_topic, word_index_map) {
-  }
-  void ComputeAndAllReduce(const LDACorpus& corpus) {
-    for (list<LDADocument*>::const_iterator iter = corpus.begin();
-         iter != corpus.end();
-         ++iter) {
-      LDADocument* document = *iter;
-      for (LDADocument::WordOccurrenceIterator iter2(document);
-           !iter2.Done(); iter2.Next()) {
-        IncrementTopic(iter2.Word(), iter2.Topic(), 1);
-      }
-    }
-    AllReduceTopicDistribution(&memory_alloc_[0], memory_alloc_.size());
+// Moves the document lines among the processes of comm, keeping their
+// order, so that every process gets a contiguous run of documents with
+// about the same number of tokens.  The prefix sums of the token counts
+// decide where each document goes, except that no process is left
+// without documents if there are at least as many documents as
+// processes.
+void BalanceDocuments(MPI_Comm comm, vector<string>* lines) {
+  int myid, pnum;
+  MPI_Comm_rank(comm, &myid);
+  MPI_Comm_size(comm, &pnum);
+  vector<int64> tokens(lines->size());
+  int64 local_tokens = 0;
+  for (int i = 0; i < lines->size(); ++i) {
+    tokens[i] = CountDocumentTokens((*lines)[i]);
+    local_tokens += tokens[i];
+  }
+  int64 tokens_before = 0;
+  int64 total_tokens = 0;
+  MPI_Exscan(&local_tokens, &tokens_before, 1, MPI_LONG_LONG, MPI_SUM, comm);
+  if (myid == 0) {
+    // MPI_Exscan leaves the result on process 0 undefined.
+    tokens_before = 0;
+  }
+  MPI_Allreduce(&local_tokens, &total_tokens, 1, MPI_LONG_LONG, MPI_SUM,
+                comm);
+  int64 local_documents = lines->size();
+  int64 documents_before = 0;
+  int64 total_documents = 0;
+  MPI_Exscan(&local_documents, &documents_before, 1, MPI_LONG_LONG, MPI_SUM,
+             comm);
+  if (myid == 0) {
+    documents_before = 0;
   }
-};
+  MPI_Allreduce(&local_documents, &total_documents, 1, MPI_LONG_LONG,
+                MPI_SUM, comm);
 
-int DistributelyLoadAndInitTrainingCorpus(
-    const string& corpus_file,
-    int num_topics,
-    int myid, int pnum, LDACorpus* corpus, set<string>* words) {
-  corpus->clear();
-  ifstream fin(corpus_file.c_str());
+  // Document g goes to process g + min(0, min over j <= g of
+  // (partition(j) - j)), where partition(j) is the prefix sum partition
+  // of document j, raised to at least the number of processes that the
+  // documents from j on must fill.  The destinations then advance by at
+  // most one process per document, and reach the last process.
+  vector<int64> partitions(lines->size());
+  int64 local_min_offset = 0;
+  int64 tokens_seen = tokens_before;
+  for (int i = 0; i < lines->size(); ++i) {
+    int64 document = documents_before + i;
+    partitions[i] = std::max(
+        static_cast<int64>(PrefixSumPartition(tokens_seen, tokens[i],
+                                              total_tokens, pnum)),
+        pnum - (total_documents - document));
+    local_min_offset = std::min(local_min_offset, partitions[i] - document);
+    tokens_seen += tokens[i];
+  }
+  int64 min_offset = 0;
+  MPI_Exscan(&local_min_offset, &min_offset, 1, MPI_LONG_LONG, MPI_MIN,
+             comm);
+  if (myid == 0) {
+    min_offset = 0;
+  }
+
+  // Lines are sent as '\n' terminated strings.
+  vector<string> send_buffers(pnum);
+  for (int i = 0; i < lines->size(); ++i) {
+    int64 document = documents_before + i;
+    min_offset = std::min(min_offset, partitions[i] - document);
+    int destination = document + min_offset;
+    send_buffers[destination].append((*lines)[i]);
+    send_buffers[destination].push_back('\n');
+  }
+  lines->clear();
+  string send_buffer;
+  vector<int> send_sizes(pnum);
+  for (int p = 0; p < pnum; ++p) {
+    send_sizes[p] = send_buffers[p].size();
+    send_buffer.append(send_buffers[p]);
+    string().swap(send_buffers[p]);
+  }
+  vector<int> receive_sizes(pnum);
+  MPI_Alltoall(&send_sizes[0], 1, MPI_INT, &receive_sizes[0], 1, MPI_INT,
+               comm);
+  vector<int> send_displacements(pnum, 0);
+  vector<int> receive_displacements(pnum, 0);
+  for (int p = 1; p < pnum; ++p) {
+    send_displacements[p] = send_displacements[p - 1] + send_sizes[p - 1];
+    receive_displacements[p] =
+        receive_displacements[p - 1] + receive_sizes[p - 1];
+  }
+  // One extra byte keeps the buffers nonempty.
+  send_buffer.push_back('\0');
+  vector<char> receive_buffer(receive_displacements[pnum - 1] +
+                              receive_sizes[pnum - 1] + 1);
+  MPI_Alltoallv(&send_buffer[0], &send_sizes[0], &send_displacements[0],
+                MPI_CHAR, &receive_buffer[0], &receive_sizes[0],
+                &receive_displacements[0], MPI_CHAR, comm);
+  string received(receive_buffer.begin(), receive_buffer.end() - 1);
+  istringstream ss(received);
   string line;
-  int index = 0;
-  while (getline(fin, line)) {  // Each line is a training document.
-    if (line.size() > 0 &&      // Skip empty lines.
-        line[0] != '\r' &&      // Skip empty lines.
-        line[0] != '\n' &&      // Skip empty lines.
-        line[0] != '#') {       // Skip comment lines.
-      istringstream ss(line);
-      if (index % pnum == myid) {
-        // This is a document that I need to store in local memory.
-        DocumentWordTopicsPB document;
-        string word;
-        int count;
-        set<string> words_in_document;
-        while (ss >> word >> count) {  // Load and init a document.
-          vector<int32> topics;
-          for (int i = 0; i < count; ++i) {
-            topics.push_back(RandInt(num_topics));
-          }
-          document.add_wordtopics(word, -1, topics);
-          words_in_document.insert(word);
-          words->insert(word);
-        }
-        if (words_in_document.size() > 0) {
-          corpus->push_back(new LDADocument(document, num_topics));
-        }
-      } else {
-        // This is a document that should be stored by other processors. I just
-        // need to read the words and build the word set.
-        string word;
-        int count;
-        while (ss >> word >> count) {  // Only fill words into word_set
-          words->insert(word);
-        }
+  while (getline(ss, line)) {
+    lines->push_back(line);
+  }
+}
+
+// Initializes documents from lines with random topics.  Adds the words
+// of the documents to words.
+int InitTrainingCorpus(const vector<string>& lines, int num_topics,
+                       LDACorpus* corpus, set<string>* words) {
+  corpus->clear();
+  for (int i = 0; i < lines.size(); ++i) {
+    istringstream ss(lines[i]);
+    DocumentWordTopicsPB document;
+    string word;
+    int count;
+    while (ss >> word >> count) {  // Load and init a document.
+      vector<int32> topics;
+      for (int i = 0; i < count; ++i) {
+        topics.push_back(RandInt(num_topics));
       }
-      index++;
+      document.add_wordtopics(word, -1, topics);
+      words->insert(word);
+    }
+    if (document.words_size() > 0) {
+      corpus->push_back(new LDADocument(document, num_topics));
     }
   }
   return corpus->size();
 }
 
+// Prints the token counts of the processes of comm on its process 0.
+void LogTokenBalance(MPI_Comm comm, const LDACorpus& corpus) {
+  int myid, pnum;
+  MPI_Comm_rank(comm, &myid);
+  MPI_Comm_size(comm, &pnum);
+  int64 local_tokens = 0;
+  for (list<LDADocument*>::const_iterator iter = corpus.begin();
+       iter != corpus.end();
+       ++iter) {
+    local_tokens += (*iter)->topics().wordtopics_size();
+  }
+  vector<int64> tokens(pnum);
+  MPI_Gather(&local_tokens, 1, MPI_LONG_LONG, &tokens[0], 1, MPI_LONG_LONG,
+             0, comm);
+  if (myid != 0) {
+    return;
+  }
+  int64 total_tokens = 0;
+  int64 max_tokens = 0;
+  std::cout << "Tokens per process:";
+  for (int p = 0; p < pnum; ++p) {
+    std::cout << " " << tokens[p];
+    total_tokens += tokens[p];
+    max_tokens = std::max(max_tokens, tokens[p]);
+  }
+  std::cout << "\nMax/mean tokens per process: "
+            << static_cast<double>(max_tokens) * pnum / total_tokens
+            << std::endl;
+}
+
 void FreeCorpus(LDACorpus* corpus) {
   for (list<LDADocument*>::iterator iter = corpus->begin();
        iter != corpus->end();
@@ -167,16 +265,81 @@ void FreeCorpus(LDACorpus* corpus) {
     }
   }
 }
+
+// Splits corpus into the synchronization periods of a sweep, which are
+// contiguous parts of about sync_tokens tokens.  Every process gets the
+// number of periods of the process with the most tokens, since the
+// synchronizations are collective.  sync_tokens 0 means one period.
+void SplitSyncPeriods(const LDACorpus& corpus, int sync_tokens,
+                      vector<LDACorpus>* periods) {
+  int64 local_tokens = 0;
+  for (list<LDADocument*>::const_iterator iter = corpus.begin();
+       iter != corpus.end();
+       ++iter) {
+    local_tokens += (*iter)->topics().wordtopics_size();
+  }
+  int64 max_tokens = 0;
+  MPI_Allreduce(&local_tokens, &max_tokens, 1, MPI_LONG_LONG, MPI_MAX,
+                MPI_COMM_WORLD);
+  int num_periods = 1;
+  if (sync_tokens > 0) {
+    num_periods = std::max(static_cast<int64>(1),
+                           (max_tokens + sync_tokens - 1) / sync_tokens);
+  }
+  periods->assign(num_periods, LDACorpus());
+  int64 tokens_before = 0;
+  for (list<LDADocument*>::const_iterator iter = corpus.begin();
+       iter != corpus.end();
+       ++iter) {
+    int64 tokens = (*iter)->topics().wordtopics_size();
+    (*periods)[PrefixSumPartition(tokens_before, tokens, local_tokens,
+                                  num_periods)].push_back(*iter);
+    tokens_before += tokens;
+  }
+}
+
+// Returns the log likelihood of the corpora of all processes.
+double ComputeLogLikelihood(const LDASampler& sampler,
+                            const LDACorpus& corpus) {
+  double loglikelihood_local = 0;
+  double loglikelihood_global = 0;
+  for (list<LDADocument*>::const_iterator iter = corpus.begin();
+       iter != corpus.end();
+       ++iter) {
+    loglikelihood_local += sampler.LogLikelihood(*iter);
+  }
+  MPI_Allreduce(&loglikelihood_local, &loglikelihood_global, 1, MPI_DOUBLE,
+                MPI_SUM, MPI_COMM_WORLD);
+  return loglikelihood_global;
+}
 }
 int main(int argc, char** argv) {
   using learning_lda::LDACorpus;
   using learning_lda::LDAModel;
   using learning_lda::ParallelLDAModel;
   using learning_lda::LDASampler;
-  using learning_lda::DistributelyLoadAndInitTrainingCorpus;
+  using learning_lda::ThreadedLDASampler;
+  using learning_lda::LDAAccumulativeModel;
+  using learning_lda::LDAModelDelta;
+  using learning_lda::WordOccurrenceIndex;
+  using learning_lda::ModelParallelLDA;
+  using learning_lda::MPIParameterServer;
+  using learning_lda::ParameterServerWorker;
+  using learning_lda::RunParameterServer;
+  using learning_lda::ReadCorpusRange;
+  using learning_lda::BalanceDocuments;
+  using learning_lda::InitTrainingCorpus;
+  using learning_lda::LogTokenBalance;
+  using learning_lda::PartitionFileName;
+  using learning_lda::DistributedVocabulary;
+  using learning_lda::ComputeLogLikelihood;
+  using learning_lda::NumaTopology;
+  using learning_lda::ScopedInterleavedMemory;
   using learning_lda::LDACmdLineFlags;
   int myid, pnum;
-  MPI_Init(&argc, &argv);
+  // Sampling threads never call MPI themselves.
+  int thread_support;
+  MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &thread_support);
   MPI_Comm_rank(MPI_COMM_WORLD, &myid);
   MPI_Comm_size(MPI_COMM_WORLD, &pnum);
 
@@ -187,58 +350,407 @@ int main(int argc, char** argv) {
   }
 
   srand(time(NULL));
+  learning_lda::SetHugePages(flags.huge_pages_ == "true");
+
+  // In parameter server mode, the first num_servers processes serve the
+  // model and only take part in building the vocabulary; the documents
+  // are split among the other processes, which form training_comm.
+  bool is_server = false;
+  if (flags.training_mode_ == "parameter_server") {
+    CHECK_LT(flags.num_servers_, pnum);
+    is_server = myid < flags.num_servers_;
+  }
+  MPI_Comm training_comm;
+  MPI_Comm_split(MPI_COMM_WORLD, is_server ? 0 : 1, myid, &training_comm);
+  int part, num_parts;
+  MPI_Comm_rank(training_comm, &part);
+  MPI_Comm_size(training_comm, &num_parts);
 
   LDACorpus corpus;
   set<string> allwords;
-  CHECK_GT(DistributelyLoadAndInitTrainingCorpus(flags.training_data_file_,
-                                     flags.num_topics_,
-                                     myid, pnum, &corpus, &allwords), 0);
-  std::cout << "Training data loaded" << std::endl;
-  // Make vocabulary words sorted and give each word an int index.
-  vector<string> sorted_words;
-  map<string, int> word_index_map;
-  for (set<string>::const_iterator iter = allwords.begin();
-       iter != allwords.end(); ++iter) {
-    sorted_words.push_back(*iter);
-  }
-  sort(sorted_words.begin(), sorted_words.end());
-  for (int i = 0; i < sorted_words.size(); ++i) {
-    word_index_map[sorted_words[i]] = i;
+  double load_start = MPI_Wtime();
+  if (!is_server) {
+    vector<string> lines;
+    if (flags.partition_mode_ == "shards") {
+      ReadCorpusRange(PartitionFileName(flags.training_data_file_, part,
+                                        num_parts), 0, 1, &lines);
+    } else {
+      ReadCorpusRange(flags.training_data_file_, part, num_parts, &lines);
+    }
+    if (flags.partition_mode_ == "balanced") {
+      BalanceDocuments(training_comm, &lines);
+    }
+    // A process may have no documents, e.g., when there are fewer
+    // documents than processes.
+    if (InitTrainingCorpus(lines, flags.num_topics_, &corpus,
+                           &allwords) == 0) {
+      LOG(WARNING) << "Process " << myid
+                   << " has no training documents\n";
+    }
+  }
+  double load_time_local = MPI_Wtime() - load_start;
+  double load_time = 0;
+  MPI_Reduce(&load_time_local, &load_time, 1, MPI_DOUBLE, MPI_MAX, 0,
+             MPI_COMM_WORLD);
+  if (myid == 0) {
+    std::cout << "Training data loaded in " << load_time << " seconds"
+              << std::endl;
   }
+  // Give each word an int index.  Only process 0, which writes the
+  // model, gets the strings of all words.
+  double vocabulary_start = MPI_Wtime();
+  DistributedVocabulary vocabulary(allwords);
+  allwords.clear();
+  const map<string, int>& word_index_map = vocabulary.word_index_map();
+  const int num_words = vocabulary.num_words();
   for (LDACorpus::iterator iter = corpus.begin(); iter != corpus.end();
        ++iter) {
     (*iter)->ResetWordIndex(word_index_map);
   }
+  vector<string> words;
+  vocabulary.Gather(0, &words);
+  if (myid == 0) {
+    std::cout << "Vocabulary of " << num_words << " words built in "
+              << MPI_Wtime() - vocabulary_start << " seconds" << std::endl;
+  }
+
+  if (!is_server) {
+    LogTokenBalance(training_comm, corpus);
+  }
+
+  if (flags.training_mode_ == "parameter_server") {
+    if (is_server) {
+      std::ofstream fout;
+      if (myid == 0) {
+        fout.open(flags.model_file_.c_str());
+      }
+      RunParameterServer(flags.num_servers_, flags.num_topics_, num_words,
+                         words, flags.staleness_, fout);
+    } else {
+      MPIParameterServer server(flags.num_servers_, flags.num_topics_);
+      ParameterServerWorker worker(myid - flags.num_servers_,
+                                   flags.num_topics_, flags.alpha_,
+                                   flags.beta_, word_index_map, num_words,
+                                   &corpus, &server);
+      worker.Initialize();
+      for (int iter = 0; iter < flags.total_iterations_; ++iter) {
+        double start = MPI_Wtime();
+        worker.DoIteration();
+        double elapsed = MPI_Wtime() - start;
+        double loglikelihood_local = 0;
+        double loglikelihood_global = 0;
+        if (flags.compute_likelihood_ == "true") {
+          loglikelihood_local = worker.LogLikelihood();
+        }
+        MPI_Reduce(&loglikelihood_local, &loglikelihood_global, 1,
+                   MPI_DOUBLE, MPI_SUM, 0, training_comm);
+        if (myid == flags.num_servers_) {
+          std::cout << "Iteration " << iter << " took " << elapsed
+                    << " seconds on worker 0\n";
+          if (flags.compute_likelihood_ == "true") {
+            std::cout << "Loglikelihood: " << loglikelihood_global
+                      << std::endl;
+          }
+        }
+      }
+      server.Finish();
+      std::cout << "Worker " << myid - flags.num_servers_ << " pulled "
+                << worker.bytes_pulled() << " bytes, pushed "
+                << worker.bytes_pushed() << " bytes" << std::endl;
+    }
+    MPI_Comm_free(&training_comm);
+    FreeCorpus(&corpus);
+    MPI_Finalize();
+    return 0;
+  }
+
+  if (flags.training_mode_ == "model_parallel") {
+    ModelParallelLDA trainer(flags.num_topics_, flags.alpha_, flags.beta_,
+                             num_words, &corpus);
+    if (myid == 0) {
+      std::cout << "Model memory per process: " << trainer.model_memory()
+                << " bytes (full model: " << trainer.full_model_memory()
+                << " bytes)" << std::endl;
+    }
+    for (int iter = 0; iter < flags.total_iterations_; ++iter) {
+      if (myid == 0) {
+        std::cout << "Iteration " << iter << " ...\n";
+      }
+      trainer.DoIteration(flags.compute_likelihood_ == "true");
+      if (myid == 0 && flags.compute_likelihood_ == "true") {
+        std::cout << "Loglikelihood: " << trainer.loglikelihood()
+                  << std::endl;
+      }
+    }
+    std::ofstream fout;
+    if (myid == 0) {
+      fout.open(flags.model_file_.c_str());
+    }
+    trainer.AppendAsString(words, fout);
+    MPI_Comm_free(&training_comm);
+    FreeCorpus(&corpus);
+    MPI_Finalize();
+    return 0;
+  }
 
+  // The model persists across iterations.  Each process records the
+  // changes it makes during an iteration, and only those are exchanged.
+  ParallelLDAModel* model;
+  {
+    ScopedInterleavedMemory interleaved(
+        flags.model_placement_ == "interleave");
+    model = new ParallelLDAModel(flags.num_topics_, num_words,
+                                 flags.shared_model_ == "true");
+  }
+  double start_time = MPI_Wtime();
+  model->ComputeAndAllReduce(corpus);
+  double init_time = MPI_Wtime() - start_time;
+  if (myid == 0) {
+    std::cout << "Model initialized in " << init_time << " seconds, "
+              << "which rebuilding the model would take every iteration"
+              << std::endl;
+  }
+  LDASampler sampler(flags.alpha_, flags.beta_, model, NULL);
+  LDAModelDelta delta(flags.num_topics_);
+  sampler.set_model_delta(&delta);
+  // The threads of a process share its model and are synchronized with
+  // the other processes together.  A sweep is sampled in one or more
+  // periods, after each of which the model may be synchronized.
+  vector<LDACorpus> periods;
+  SplitSyncPeriods(corpus, flags.sync_tokens_, &periods);
+  vector<ThreadedLDASampler*> period_samplers;
+  for (int p = 0; p < periods.size(); ++p) {
+    period_samplers.push_back(new ThreadedLDASampler(
+        flags.alpha_, flags.beta_, model, periods[p], flags.num_threads_));
+  }
+  NumaTopology topology;
+  if (flags.pin_threads_ == "true") {
+    for (int p = 0; p < period_samplers.size(); ++p) {
+      period_samplers[p]->PinThreads(&topology);
+    }
+    if (myid == 0) {
+      std::cout << "Sampling threads pinned over " << topology.num_nodes()
+                << " NUMA nodes" << std::endl;
+    }
+  }
+  if (myid == 0) {
+    std::cout << "Model memory per process: "
+              << model->dense_bytes() << " bytes, shared by "
+              << flags.num_threads_ << " threads";
+    if (model->node_shared()) {
+      std::cout << " and the " << model->node_size()
+                << " processes of the node";
+    }
+    std::cout << std::endl;
+    std::cout << periods.size() << " synchronization periods per sweep"
+              << std::endl;
+  }
+  // After burn_in_iterations, every process accumulates the words it
+  // owns in the vocabulary from its synchronized copy of the model, so
+  // the average is sharded without further communication.
+  LDAAccumulativeModel* accum_model = NULL;
+  int num_accumulations = 0;
+  if (flags.burn_in_iterations_ >= 0) {
+    accum_model = new LDAAccumulativeModel(flags.num_topics_,
+                                           vocabulary.owned_words().size());
+  }
+  // The pipelined mode sweeps the corpus in word order.
+  WordOccurrenceIndex* word_occurrences = NULL;
+  if (flags.sync_mode_ == "pipelined") {
+    word_occurrences = new WordOccurrenceIndex(corpus, model->num_words());
+  }
+  double total_sampling_time = 0;
+  double total_sync_time = 0;
+  int total_syncs = 0;
   for (int iter = 0; iter < flags.total_iterations_; ++iter) {
     if (myid == 0) {
       std::cout << "Iteration " << iter << " ...\n";
     }
-    ParallelLDAModel model(flags.num_topics_, word_index_map);
-    model.ComputeAndAllReduce(corpus);
-    LDASampler sampler(flags.alpha_, flags.beta_, &model, NULL);
     if (flags.compute_likelihood_ == "true") {
-      double loglikelihood_local = 0;
-      double loglikelihood_global = 0;
-      for (list<LDADocument*>::const_iterator iter = corpus.begin();
-           iter != corpus.end();
-           ++iter) {
-        loglikelihood_local += sampler.LogLikelihood(*iter);
+      double loglikelihood = ComputeLogLikelihood(sampler, corpus);
+      if (myid == 0) {
+        std::cout << "Loglikelihood: " << loglikelihood << std::endl;
       }
-      MPI_Allreduce(&loglikelihood_local, &loglikelihood_global, 1, MPI_DOUBLE,
-                    MPI_SUM, MPI_COMM_WORLD);
+    }
+    double sampling_start = MPI_Wtime();
+    if (word_occurrences != NULL) {
+      model->SampleAndAllReduce(*word_occurrences, &sampler, &delta,
+                               flags.sync_chunks_);
+      double end = MPI_Wtime();
+      double overlap_local = model->overlap_ratio();
+      double overlap_global = 0;
+      MPI_Reduce(&overlap_local, &overlap_global, 1, MPI_DOUBLE, MPI_SUM, 0,
+                 MPI_COMM_WORLD);
       if (myid == 0) {
-        std::cout << "Loglikelihood: " << loglikelihood_global << std::endl;
+        std::cout << "Sampling and synchronization " << end - sampling_start
+                  << " seconds, overlap ratio " << overlap_global / pnum
+                  << std::endl;
+      }
+      if (accum_model != NULL && iter >= flags.burn_in_iterations_) {
+        accum_model->AccumulateWords(*model, vocabulary.owned_begin());
+        ++num_accumulations;
+      }
+      continue;
+    }
+    // With staleness S, a process waits only for the synchronization
+    // started S periods ago, so it may run up to S periods ahead of the
+    // slowest process.
+    double sampling_time = 0;
+    double sync_time = 0;
+    int syncs = 0;
+    int64 bytes_local = 0;
+    // Encoded bytes, encoding and decoding seconds of compressed and
+    // reduce_scatter syncs.
+    double codec_stats[3] = { 0, 0, 0 };
+    bool sync_sweep = (iter + 1) % flags.sync_interval_ == 0 ||
+        iter == flags.total_iterations_ - 1;
+    for (int p = 0; p < periods.size(); ++p) {
+      double period_start = MPI_Wtime();
+      period_samplers[p]->DoIteration(&delta);
+      double sync_start = MPI_Wtime();
+      sampling_time += sync_start - period_start;
+      if (!sync_sweep) {
+        continue;
+      }
+      if (flags.staleness_ > 0) {
+        model->StartDenseAllReduce(&delta);
+        while (model->num_in_flight() > flags.staleness_) {
+          model->FinishDenseAllReduce();
+        }
+      } else if (flags.sync_mode_ == "sparse") {
+        model->SparseAllReduce(&delta);
+      } else if (flags.sync_mode_ == "compressed" ||
+                 flags.sync_mode_ == "reduce_scatter") {
+        if (flags.sync_mode_ == "compressed") {
+          model->CompressedAllReduce(&delta);
+        } else {
+          model->ReduceScatterAllReduce(&delta);
+        }
+        codec_stats[0] += model->encoded_bytes();
+        codec_stats[1] += model->encode_time();
+        codec_stats[2] += model->decode_time();
+      } else {
+        model->DenseAllReduce(&delta);
+      }
+      sync_time += MPI_Wtime() - sync_start;
+      bytes_local += model->bytes_communicated();
+      ++syncs;
+    }
+    if (iter == flags.total_iterations_ - 1) {
+      double drain_start = MPI_Wtime();
+      while (model->FinishDenseAllReduce()) {
+      }
+      sync_time += MPI_Wtime() - drain_start;
+    }
+    if (accum_model != NULL && iter >= flags.burn_in_iterations_ &&
+        sync_sweep) {
+      accum_model->AccumulateWords(*model, vocabulary.owned_begin());
+      ++num_accumulations;
+    }
+    total_sampling_time += sampling_time;
+    total_sync_time += sync_time;
+    total_syncs += syncs;
+    int64 bytes_global = 0;
+    MPI_Reduce(&bytes_local, &bytes_global, 1, MPI_LONG_LONG, MPI_SUM, 0,
+               MPI_COMM_WORLD);
+    // Everyone waits for the slowest process in the synchronization.
+    double max_sampling_time = 0;
+    double sum_sampling_time = 0;
+    double sum_sync_time = 0;
+    MPI_Reduce(&sampling_time, &max_sampling_time, 1, MPI_DOUBLE, MPI_MAX, 0,
+               MPI_COMM_WORLD);
+    MPI_Reduce(&sampling_time, &sum_sampling_time, 1, MPI_DOUBLE, MPI_SUM,
+               0, MPI_COMM_WORLD);
+    MPI_Reduce(&sync_time, &sum_sync_time, 1, MPI_DOUBLE, MPI_SUM, 0,
+               MPI_COMM_WORLD);
+    if (myid == 0) {
+      std::cout << "Sampling " << sum_sampling_time / pnum
+                << " seconds on average, " << max_sampling_time
+                << " seconds at most, synchronization " << sum_sync_time / pnum
+                << " seconds in " << syncs << " synchronizations, "
+                << bytes_global / pnum
+                << " bytes per process (dense: " << model->dense_bytes()
+                << " bytes)" << std::endl;
+    }
+    if (flags.sync_mode_ == "compressed" ||
+        flags.sync_mode_ == "reduce_scatter") {
+      double global_codec_stats[3] = { 0, 0, 0 };
+      MPI_Reduce(codec_stats, global_codec_stats, 3, MPI_DOUBLE, MPI_SUM, 0,
+                 MPI_COMM_WORLD);
+      if (myid == 0 && syncs > 0) {
+        double encoded_bytes = global_codec_stats[0] / pnum;
+        std::cout << "Compressed changes to " << encoded_bytes
+                  << " bytes per process, ratio "
+                  << static_cast<double>(model->dense_bytes()) * syncs /
+                     encoded_bytes
+                  << " to dense, encoding " << global_codec_stats[1] / pnum
+                  << " seconds, decoding " << global_codec_stats[2] / pnum
+                  << " seconds" << std::endl;
       }
     }
-    sampler.DoIteration(&corpus, true, false);
   }
-  ParallelLDAModel model(flags.num_topics_, word_index_map);
-  model.ComputeAndAllReduce(corpus);
-  if (myid == 0) {
+  if (word_occurrences == NULL) {
+    double sums[2] = { total_sampling_time, total_sync_time };
+    double global_sums[2] = { 0, 0 };
+    MPI_Reduce(sums, global_sums, 2, MPI_DOUBLE, MPI_SUM, 0, MPI_COMM_WORLD);
+    if (myid == 0) {
+      std::cout << "Sampling " << global_sums[0] / pnum
+                << " seconds, synchronization " << global_sums[1] / pnum
+                << " seconds in " << total_syncs
+                << " synchronizations per process in total" << std::endl;
+    }
+  }
+  if (flags.compute_likelihood_ == "true") {
+    double loglikelihood = ComputeLogLikelihood(sampler, corpus);
+    if (myid == 0) {
+      std::cout << "Final loglikelihood: " << loglikelihood << std::endl;
+    }
+  }
+  if (accum_model != NULL) {
+    CHECK_LT(0, num_accumulations);
+    accum_model->AverageModel(num_accumulations);
+    std::ofstream fout(PartitionFileName(flags.model_file_, myid,
+                                         pnum).c_str());
+    accum_model->AppendAsString(vocabulary.owned_words(), fout);
+    if (myid == 0) {
+      std::cout << "Averaged " << num_accumulations << " samples into "
+                << PartitionFileName(flags.model_file_, 0, pnum) << " to "
+                << PartitionFileName(flags.model_file_, pnum - 1, pnum)
+                << std::endl;
+    }
+  } else if (myid == 0) {
     std::ofstream fout(flags.model_file_.c_str());
-    model.AppendAsString(fout);
+    model->AppendAsString(words, fout);
+  }
+  if (flags.pin_threads_ == "true" && myid == 0) {
+    // The throughput of a node is the sum of those of its threads.
+    vector<double> node_throughput(topology.num_nodes(), 0);
+    vector<int> node_threads(topology.num_nodes(), 0);
+    for (int t = 0; t < flags.num_threads_; ++t) {
+      int64 tokens = 0;
+      double seconds = 0;
+      for (int p = 0; p < period_samplers.size(); ++p) {
+        tokens += period_samplers[p]->tokens_sampled(t);
+        seconds += period_samplers[p]->sampling_time(t);
+      }
+      if (seconds > 0) {
+        node_throughput[topology.ThreadNode(t)] += tokens / seconds;
+      }
+      ++node_threads[topology.ThreadNode(t)];
+    }
+    for (int n = 0; n < topology.num_nodes(); ++n) {
+      std::cout << "NUMA node " << n << ": " << node_threads[n]
+                << " threads, " << node_throughput[n]
+                << " tokens per second" << std::endl;
+    }
+  }
+  delete accum_model;
+  delete word_occurrences;
+  for (int p = 0; p < period_samplers.size(); ++p) {
+    delete period_samplers[p];
   }
+  delete model;
+  MPI_Comm_free(&training_comm);
   FreeCorpus(&corpus);
   MPI_Finalize();
   return 0;
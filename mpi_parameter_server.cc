@@ -0,0 +1,226 @@
+// Copyright 2008 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mpi_parameter_server.h"
+
+#include <list>
+#include <utility>
+
+namespace learning_lda {
+
+namespace {
+
+// Message tags.  All messages are arrays of int64.
+const int kPullTag = 1;
+const int kPullReplyTag = 2;
+const int kPushTag = 3;
+const int kClockTag = 4;
+const int kClockReplyTag = 5;
+const int kFinishTag = 6;
+const int kShardTag = 7;
+
+}  // namespace
+
+MPIParameterServer::MPIParameterServer(int num_servers, int num_topics)
+    : num_servers_(num_servers),
+      num_topics_(num_topics),
+      push_buffers_(num_servers),
+      push_requests_(num_servers, MPI_REQUEST_NULL) {
+}
+
+MPIParameterServer::~MPIParameterServer() {
+  WaitForPushes();
+}
+
+void MPIParameterServer::Pull(const vector<int>& words, int64* rows,
+                              int64* global) {
+  vector<vector<int64> > requests(num_servers_);
+  vector<vector<int> > positions(num_servers_);
+  for (int i = 0; i < words.size(); ++i) {
+    requests[words[i] % num_servers_].push_back(words[i]);
+    positions[words[i] % num_servers_].push_back(i);
+  }
+  vector<MPI_Request> request_handles(num_servers_);
+  for (int s = 0; s < num_servers_; ++s) {
+    int64 dummy = 0;
+    MPI_Isend(requests[s].empty() ? &dummy : &requests[s][0],
+              requests[s].size(), MPI_LONG_LONG, s, kPullTag,
+              MPI_COMM_WORLD, &request_handles[s]);
+  }
+  std::fill(global, global + num_topics_, 0);
+  vector<int64> reply;
+  for (int s = 0; s < num_servers_; ++s) {
+    // The reply holds the requested rows followed by the topic counts of
+    // the shard.
+    reply.resize((requests[s].size() + 1) * num_topics_);
+    MPI_Recv(&reply[0], reply.size(), MPI_LONG_LONG, s, kPullReplyTag,
+             MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+    for (int j = 0; j < positions[s].size(); ++j) {
+      std::copy(reply.begin() + static_cast<int64>(j) * num_topics_,
+                reply.begin() + static_cast<int64>(j + 1) * num_topics_,
+                rows + static_cast<int64>(positions[s][j]) * num_topics_);
+    }
+    for (int k = 0; k < num_topics_; ++k) {
+      global[k] += reply[positions[s].size() * num_topics_ + k];
+    }
+  }
+  MPI_Waitall(num_servers_, &request_handles[0], MPI_STATUSES_IGNORE);
+}
+
+void MPIParameterServer::Push(const LDAModelDelta& delta) {
+  WaitForPushes();
+  for (int s = 0; s < num_servers_; ++s) {
+    push_buffers_[s].clear();
+  }
+  const vector<int64>& cells = delta.cells();
+  const vector<int32>& counts = delta.counts();
+  for (int64 i = 0; i < cells.size(); ++i) {
+    vector<int64>& buffer = push_buffers_[(cells[i] / num_topics_) %
+                                          num_servers_];
+    buffer.push_back(cells[i]);
+    buffer.push_back(counts[i]);
+  }
+  for (int s = 0; s < num_servers_; ++s) {
+    if (!push_buffers_[s].empty()) {
+      MPI_Isend(&push_buffers_[s][0], push_buffers_[s].size(),
+                MPI_LONG_LONG, s, kPushTag, MPI_COMM_WORLD,
+                &push_requests_[s]);
+    }
+  }
+}
+
+void MPIParameterServer::Clock(int worker) {
+  // A server handles the messages of a worker in order, so it replies
+  // after it has applied the pushes sent before.
+  int64 dummy = 0;
+  for (int s = 0; s < num_servers_; ++s) {
+    MPI_Send(&dummy, 1, MPI_LONG_LONG, s, kClockTag, MPI_COMM_WORLD);
+  }
+  for (int s = 0; s < num_servers_; ++s) {
+    MPI_Recv(&dummy, 1, MPI_LONG_LONG, s, kClockReplyTag, MPI_COMM_WORLD,
+             MPI_STATUS_IGNORE);
+  }
+}
+
+void MPIParameterServer::Finish() {
+  WaitForPushes();
+  int64 dummy = 0;
+  for (int s = 0; s < num_servers_; ++s) {
+    MPI_Send(&dummy, 1, MPI_LONG_LONG, s, kFinishTag, MPI_COMM_WORLD);
+  }
+}
+
+void MPIParameterServer::WaitForPushes() {
+  MPI_Waitall(num_servers_, &push_requests_[0], MPI_STATUSES_IGNORE);
+}
+
+void RunParameterServer(int num_servers, int num_topics, int num_words,
+                        const vector<string>& words, int staleness,
+                        std::ostream& out) {
+  int myid, pnum;
+  MPI_Comm_rank(MPI_COMM_WORLD, &myid);
+  MPI_Comm_size(MPI_COMM_WORLD, &pnum);
+  const int num_workers = pnum - num_servers;
+  ParameterServerShard shard(myid, num_servers, num_topics, num_words);
+  BoundedStalenessClock clock(num_workers, staleness);
+  // Workers waiting for a clock reply, with their clocks.
+  std::list<std::pair<int, int64> > waiting;
+  int num_finished = 0;
+  vector<int64> message;
+  vector<int64> reply;
+  while (num_finished < num_workers) {
+    MPI_Status status;
+    MPI_Probe(MPI_ANY_SOURCE, MPI_ANY_TAG, MPI_COMM_WORLD, &status);
+    int count;
+    MPI_Get_count(&status, MPI_LONG_LONG, &count);
+    message.resize(std::max(count, 1));
+    MPI_Recv(&message[0], count, MPI_LONG_LONG, status.MPI_SOURCE,
+             status.MPI_TAG, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+    int worker = status.MPI_SOURCE - num_servers;
+    if (status.MPI_TAG == kPullTag) {
+      reply.resize(static_cast<int64>(count + 1) * num_topics);
+      for (int i = 0; i < count; ++i) {
+        shard.GetRow(message[i], &reply[static_cast<int64>(i) * num_topics]);
+      }
+      std::copy(shard.topic_counts().begin(), shard.topic_counts().end(),
+                reply.begin() + static_cast<int64>(count) * num_topics);
+      MPI_Send(&reply[0], reply.size(), MPI_LONG_LONG, status.MPI_SOURCE,
+               kPullReplyTag, MPI_COMM_WORLD);
+    } else if (status.MPI_TAG == kPushTag) {
+      for (int i = 0; i < count; i += 2) {
+        shard.Add(message[i] / num_topics, message[i] % num_topics,
+                  message[i + 1]);
+      }
+    } else if (status.MPI_TAG == kClockTag || status.MPI_TAG == kFinishTag) {
+      if (status.MPI_TAG == kClockTag) {
+        waiting.push_back(std::make_pair(status.MPI_SOURCE,
+                                         clock.Tick(worker)));
+      } else {
+        clock.Finish(worker);
+        ++num_finished;
+      }
+      for (std::list<std::pair<int, int64> >::iterator iter =
+               waiting.begin(); iter != waiting.end();) {
+        if (clock.CanProceed(iter->second)) {
+          int64 dummy = 0;
+          MPI_Send(&dummy, 1, MPI_LONG_LONG, iter->first, kClockReplyTag,
+                   MPI_COMM_WORLD);
+          iter = waiting.erase(iter);
+        } else {
+          ++iter;
+        }
+      }
+    }
+  }
+
+  // Process 0 collects the shards and writes the model.
+  if (myid != 0) {
+    vector<int64> rows;
+    vector<int64> row(num_topics);
+    for (int w = myid; w < num_words; w += num_servers) {
+      shard.GetRow(w, &row[0]);
+      rows.insert(rows.end(), row.begin(), row.end());
+    }
+    int64 dummy = 0;
+    MPI_Send(rows.empty() ? &dummy : &rows[0], rows.size(), MPI_LONG_LONG, 0,
+             kShardTag, MPI_COMM_WORLD);
+    return;
+  }
+  vector<vector<int64> > shard_rows(num_servers);
+  for (int s = 1; s < num_servers; ++s) {
+    shard_rows[s].resize(static_cast<int64>(num_words / num_servers + 1) *
+                         num_topics);
+    MPI_Recv(&shard_rows[s][0], shard_rows[s].size(), MPI_LONG_LONG, s,
+             kShardTag, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+  }
+  vector<int64> row(num_topics);
+  for (int w = 0; w < num_words; ++w) {
+    int s = w % num_servers;
+    if (s == 0) {
+      shard.GetRow(w, &row[0]);
+    } else {
+      std::copy(shard_rows[s].begin() +
+                static_cast<int64>(w / num_servers) * num_topics,
+                shard_rows[s].begin() +
+                static_cast<int64>(w / num_servers + 1) * num_topics,
+                row.begin());
+    }
+    out << words[w] << "\t";
+    for (int k = 0; k < num_topics; ++k) {
+      out << row[k] << ((k < num_topics - 1) ? " " : "\n");
+    }
+  }
+}
+
+}  // namespace learning_lda
@@ -0,0 +1,70 @@
+// Copyright 2008 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef _OPENSOURCE_GLDA_MPI_PARAMETER_SERVER_H__
+#define _OPENSOURCE_GLDA_MPI_PARAMETER_SERVER_H__
+
+#include "mpi.h"
+
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "common.h"
+#include "model.h"
+#include "parameter_server.h"
+
+namespace learning_lda {
+
+// MPIParameterServer is the worker side of a parameter server whose
+// shards live on the MPI processes 0 to num_servers - 1, each of which
+// runs RunParameterServer.  Shard s holds the words whose index modulo
+// num_servers is s.  Pulls are batched into one request per server,
+// pushes are sent without waiting for the servers, and clocks are sent
+// to every server, which replies once the staleness bound allows.
+class MPIParameterServer : public ParameterServer {
+ public:
+  MPIParameterServer(int num_servers, int num_topics);
+  virtual ~MPIParameterServer();
+
+  virtual void Pull(const vector<int>& words, int64* rows, int64* global);
+  virtual void Push(const LDAModelDelta& delta);
+  virtual void Clock(int worker);
+
+  // Tells the servers that this worker is finished.
+  void Finish();
+
+ private:
+  // Waits for the pushes in flight, whose buffers are then reused.
+  void WaitForPushes();
+
+  const int num_servers_;
+  const int num_topics_;
+  vector<vector<int64> > push_buffers_;
+  vector<MPI_Request> push_requests_;
+};
+
+// Serves shard myid of a parameter server to the worker processes
+// num_servers to pnum - 1 until all of them are finished, then writes
+// the model in the format of LDAModel::AppendAsString to out on process
+// 0, which receives the other shards.  words[i] is the string of word i
+// and is only needed on process 0.
+void RunParameterServer(int num_servers, int num_topics, int num_words,
+                        const vector<string>& words, int staleness,
+                        std::ostream& out);
+
+}  // namespace learning_lda
+
+#endif  // _OPENSOURCE_GLDA_MPI_PARAMETER_SERVER_H__
@@ -0,0 +1,171 @@
+// Copyright 2008 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "numa_placement.h"
+
+#include <dirent.h>
+#include <linux/mempolicy.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+
+namespace learning_lda {
+
+namespace {
+
+const char kNodePath[] = "/sys/devices/system/node";
+
+bool huge_pages_enabled = false;
+
+// Parses a list of CPUs or nodes like "0-3,8-11".
+void ParseList(const string& list, vector<int>* cpus) {
+  std::istringstream ss(list);
+  string range;
+  while (getline(ss, range, ',')) {
+    int first, last;
+    char dash;
+    std::istringstream range_ss(range);
+    if (!(range_ss >> first)) {
+      continue;
+    }
+    last = first;
+    if (range_ss >> dash >> last) {
+      CHECK_EQ('-', dash);
+    }
+    for (int cpu = first; cpu <= last; ++cpu) {
+      cpus->push_back(cpu);
+    }
+  }
+}
+
+}  // namespace
+
+NumaTopology::NumaTopology() {
+  cpu_set_t allowed;
+  CPU_ZERO(&allowed);
+  CHECK_EQ(0, sched_getaffinity(0, sizeof(allowed), &allowed));
+  // Nodes by id, as the directory lists them in any order.
+  map<int, vector<int> > nodes;
+  DIR* dir = opendir(kNodePath);
+  if (dir != NULL) {
+    struct dirent* entry;
+    while ((entry = readdir(dir)) != NULL) {
+      int node;
+      char rest;
+      if (sscanf(entry->d_name, "node%d%c", &node, &rest) != 1) {
+        continue;
+      }
+      std::ifstream fin((string(kNodePath) + "/" + entry->d_name +
+                         "/cpulist").c_str());
+      string list;
+      getline(fin, list);
+      vector<int> cpus;
+      ParseList(list, &cpus);
+      for (int i = 0; i < cpus.size(); ++i) {
+        if (CPU_ISSET(cpus[i], &allowed)) {
+          nodes[node].push_back(cpus[i]);
+        }
+      }
+    }
+    closedir(dir);
+  }
+  for (map<int, vector<int> >::const_iterator iter = nodes.begin();
+       iter != nodes.end(); ++iter) {
+    node_cpus_.push_back(iter->second);
+  }
+  if (node_cpus_.empty()) {
+    node_cpus_.resize(1);
+    for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+      if (CPU_ISSET(cpu, &allowed)) {
+        node_cpus_[0].push_back(cpu);
+      }
+    }
+  }
+}
+
+int NumaTopology::ThreadNode(int i) const {
+  return i % node_cpus_.size();
+}
+
+int NumaTopology::ThreadCpu(int i) const {
+  const vector<int>& cpus = node_cpus_[ThreadNode(i)];
+  return cpus[(i / node_cpus_.size()) % cpus.size()];
+}
+
+bool PinThreadToCpu(int cpu) {
+  cpu_set_t cpus;
+  CPU_ZERO(&cpus);
+  CPU_SET(cpu, &cpus);
+  return pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus) == 0;
+}
+
+ScopedInterleavedMemory::ScopedInterleavedMemory(bool interleave)
+    : interleave_(interleave) {
+  if (interleave_) {
+    std::ifstream fin((string(kNodePath) + "/has_memory").c_str());
+    string list;
+    getline(fin, list);
+    vector<int> nodes;
+    ParseList(list, &nodes);
+    unsigned long mask[16];
+    const int bits_per_word = sizeof(mask[0]) * 8;
+    memset(mask, 0, sizeof(mask));
+    for (int i = 0; i < nodes.size(); ++i) {
+      if (nodes[i] < sizeof(mask) * 8) {
+        mask[nodes[i] / bits_per_word] |= 1UL << (nodes[i] % bits_per_word);
+      }
+    }
+    if (nodes.empty() ||
+        syscall(SYS_set_mempolicy, MPOL_INTERLEAVE, mask,
+                sizeof(mask) * 8 + 1) != 0) {
+      LOG(WARNING) << "Failed to interleave memory over NUMA nodes\n";
+      interleave_ = false;
+    }
+  }
+}
+
+ScopedInterleavedMemory::~ScopedInterleavedMemory() {
+  if (interleave_) {
+    syscall(SYS_set_mempolicy, MPOL_DEFAULT, NULL, 0);
+  }
+}
+
+void SetHugePages(bool enabled) {
+  huge_pages_enabled = enabled;
+}
+
+void AdviseHugePages(void* address, int64 bytes) {
+  if (!huge_pages_enabled || bytes <= 0) {
+    return;
+  }
+  const uintptr_t page_size = sysconf(_SC_PAGESIZE);
+  uintptr_t begin = reinterpret_cast<uintptr_t>(address);
+  uintptr_t end = begin + bytes;
+  begin = (begin + page_size - 1) / page_size * page_size;
+  end = end / page_size * page_size;
+  if (begin < end &&
+      madvise(reinterpret_cast<void*>(begin), end - begin,
+              MADV_HUGEPAGE) != 0) {
+    LOG(WARNING) << "Failed to use huge pages\n";
+  }
+}
+
+}  // namespace learning_lda
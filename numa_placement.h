@@ -0,0 +1,70 @@
+// Copyright 2008 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef _OPENSOURCE_GLDA_NUMA_PLACEMENT_H__
+#define _OPENSOURCE_GLDA_NUMA_PLACEMENT_H__
+
+#include <vector>
+
+#include "common.h"
+
+namespace learning_lda {
+
+// NumaTopology lists the CPUs of every NUMA node that the process may run
+// on, as read from /sys/devices/system/node.  A machine without NUMA
+// information is one node of all its CPUs.
+class NumaTopology {
+ public:
+  NumaTopology();
+  ~NumaTopology() {}
+
+  int num_nodes() const { return node_cpus_.size(); }
+
+  // Returns the node and the CPU of the i-th of several threads, which
+  // are spread over the nodes round robin, so that every node gets about
+  // the same number of threads, and over the CPUs of a node in order.
+  int ThreadNode(int i) const;
+  int ThreadCpu(int i) const;
+
+ private:
+  vector<vector<int> > node_cpus_;
+};
+
+// Pins the calling thread to cpu.  Returns false on failure.
+bool PinThreadToCpu(int cpu);
+
+// While an object of this class exists, the pages first touched by the
+// thread that created it are interleaved over all NUMA nodes, if
+// interleave is true, instead of being placed on the node of the thread.
+// Used to place a model that threads of every node read.
+class ScopedInterleavedMemory {
+ public:
+  explicit ScopedInterleavedMemory(bool interleave);
+  ~ScopedInterleavedMemory();
+
+ private:
+  bool interleave_;
+};
+
+// Enables AdviseHugePages, which is off by default.
+void SetHugePages(bool enabled);
+
+// Asks for transparent huge pages for the pages within
+// [address, address + bytes), if enabled by SetHugePages.  Should be
+// called before the memory is first touched.
+void AdviseHugePages(void* address, int64 bytes);
+
+}  // namespace learning_lda
+
+#endif  // _OPENSOURCE_GLDA_NUMA_PLACEMENT_H__
@@ -0,0 +1,206 @@
+// Copyright 2008 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+/*
+  Trains a model online from a stream of documents.  An example running
+  of this program:
+
+  ./online_lda \
+  --num_topics 2 \
+  --alpha 0.1    \
+  --beta 0.01                                           \
+  --training_data_file ./testdata/test_data.txt \
+  --model_file /tmp/lda_model.txt                       \
+  --total_iterations 10                                 \
+  --minibatch_size 1024
+
+  training_data_file may be - to read the documents from the standard
+  input.  Every document is read once.  The documents are sampled
+  minibatch by minibatch, total_iterations times each, against the model
+  learned so far, and then merged into the model with the step size
+  rho_t = (tau0 + t)^-kappa of the t-th minibatch.  Only the model and
+  one minibatch are kept in memory.
+*/
+
+#include <math.h>
+
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <map>
+
+#include "common.h"
+#include "document.h"
+#include "online_model.h"
+#include "vocabulary.h"
+#include "cmd_flags.h"
+
+namespace learning_lda {
+
+using std::istringstream;
+using std::map;
+
+// Reads up to minibatch_size documents from in and initializes their
+// topics randomly, with their words mapped by vocabulary_filter.  The
+// documents index their words locally, and (*words)[i] is the model word
+// of local word i.  New words are added to word_index_map.  Returns the
+// number of documents read.
+int ReadMinibatch(std::istream& in,
+                  int num_topics,
+                  int minibatch_size,
+                  const VocabularyFilter& vocabulary_filter,
+                  map<string, int>* word_index_map,
+                  LDACorpus* minibatch,
+                  vector<int>* words) {
+  minibatch->clear();
+  words->clear();
+  map<int, int> local_index_map;
+  string line;
+  while (minibatch->size() < minibatch_size && getline(in, line)) {
+    if (line.size() > 0 &&      // Skip empty lines.
+        line[0] != '\r' &&      // Skip empty lines.
+        line[0] != '\n' &&      // Skip empty lines.
+        line[0] != '#') {       // Skip comment lines.
+      istringstream ss(line);
+      DocumentWordTopicsPB document;
+      string word;
+      string model_word;
+      int count;
+      while (ss >> word >> count) {
+        if (!vocabulary_filter.Map(word, &model_word)) {
+          continue;
+        }
+        vector<int32> topics;
+        for (int i = 0; i < count; ++i) {
+          topics.push_back(RandInt(num_topics));
+        }
+        map<string, int>::const_iterator iter =
+            word_index_map->find(model_word);
+        int word_index;
+        if (iter == word_index_map->end()) {
+          word_index = word_index_map->size();
+          (*word_index_map)[model_word] = word_index;
+        } else {
+          word_index = iter->second;
+        }
+        map<int, int>::const_iterator local_iter =
+            local_index_map.find(word_index);
+        int local_index;
+        if (local_iter == local_index_map.end()) {
+          local_index = words->size();
+          local_index_map[word_index] = local_index;
+          words->push_back(word_index);
+        } else {
+          local_index = local_iter->second;
+        }
+        document.add_wordtopics(model_word, local_index, topics);
+      }
+      minibatch->push_back(new LDADocument(document, num_topics));
+    }
+  }
+  return minibatch->size();
+}
+
+void FreeCorpus(LDACorpus* corpus) {
+  for (list<LDADocument*>::iterator iter = corpus->begin();
+       iter != corpus->end();
+       ++iter) {
+    if (*iter != NULL) {
+      delete *iter;
+      *iter = NULL;
+    }
+  }
+}
+
+}  // namespace learning_lda
+
+int main(int argc, char** argv) {
+  using learning_lda::LDACorpus;
+  using learning_lda::LDAOnlineModel;
+  using learning_lda::LDAOnlineSampler;
+  using learning_lda::LDACmdLineFlags;
+  using learning_lda::LDADocument;
+  using learning_lda::VocabularyFilter;
+  using learning_lda::WallTime;
+
+  LDACmdLineFlags flags;
+  flags.ParseCmdFlags(argc, argv);
+  if (!flags.CheckOnlineTrainingValidity()) {
+    return -1;
+  }
+  srand(time(NULL));
+
+  std::ifstream fin;
+  std::istream* in = &std::cin;
+  if (flags.training_data_file_ != "-") {
+    fin.open(flags.training_data_file_.c_str());
+    in = &fin;
+  }
+
+  VocabularyFilter vocabulary_filter(flags);
+  map<string, int> word_index_map;
+  LDAOnlineModel model(flags.num_topics_);
+  LDAOnlineSampler sampler(flags.alpha_, flags.beta_, &model);
+  int64 num_documents_read = 0;
+  LDACorpus minibatch;
+  vector<int> words;
+  for (int t = 0; ; ++t) {
+    double start = WallTime();
+    int num_documents = learning_lda::ReadMinibatch(
+        *in, flags.num_topics_, flags.minibatch_size_, vocabulary_filter,
+        &word_index_map, &minibatch, &words);
+    if (num_documents == 0) {
+      break;
+    }
+    num_documents_read += num_documents;
+    model.Resize(word_index_map.size());
+    sampler.StartMinibatch(minibatch, words);
+    for (int iter = 0; iter < flags.total_iterations_; ++iter) {
+      sampler.DoIteration(&minibatch);
+    }
+
+    std::cout << "Minibatch " << t << ": " << num_documents
+              << " documents, " << word_index_map.size() << " words";
+    if (flags.compute_likelihood_ == "true") {
+      double loglikelihood = 0;
+      int64 num_tokens = 0;
+      for (list<LDADocument*>::const_iterator iterator = minibatch.begin();
+           iterator != minibatch.end();
+           ++iterator) {
+        loglikelihood += sampler.LogLikelihood(*iterator);
+        for (LDADocument::WordOccurrenceIterator iter2(*iterator);
+             !iter2.Done();
+             iter2.Next()) {
+          ++num_tokens;
+        }
+      }
+      std::cout << ", loglikelihood per word " << loglikelihood / num_tokens;
+    }
+
+    // The minibatch counts are scaled to the size of the corpus, which
+    // is the number of documents read so far unless it is given.
+    double rho = pow(flags.tau0_ + t, -flags.kappa_);
+    double corpus_size = flags.num_documents_ > 0 ?
+        flags.num_documents_ : num_documents_read;
+    model.Update(sampler.minibatch_model(), sampler.words(), rho,
+                 corpus_size / num_documents);
+    learning_lda::FreeCorpus(&minibatch);
+    std::cout << ", rho " << rho << ", " << WallTime() - start
+              << " seconds" << std::endl;
+  }
+
+  std::ofstream fout(flags.model_file_.c_str());
+  vocabulary_filter.AppendAsString(fout);
+  model.AppendAsString(word_index_map, fout);
+  return 0;
+}
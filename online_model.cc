@@ -0,0 +1,202 @@
+// Copyright 2008 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "online_model.h"
+
+#include <math.h>
+
+#include <algorithm>
+
+namespace learning_lda {
+
+namespace {
+
+// scale_ is folded into the values in memory before it underflows.
+const double kMinScale = 1e-100;
+
+}  // namespace
+
+LDAOnlineModel::LDAOnlineModel(int num_topics)
+    : num_topics_(num_topics),
+      scale_(1),
+      global_distribution_(num_topics, 0) {
+  CHECK_LT(0, num_topics);
+}
+
+void LDAOnlineModel::Resize(int num_words) {
+  CHECK_LE(this->num_words(), num_words);
+  topic_distributions_.resize(static_cast<int64>(num_words) * num_topics_, 0);
+}
+
+void LDAOnlineModel::Update(const LDAModel& minibatch_model,
+                            const vector<int>& words,
+                            double rho, double weight) {
+  CHECK_EQ(num_topics_, minibatch_model.num_topics());
+  CHECK_EQ(words.size(), minibatch_model.num_words());
+  CHECK_LT(0.0, rho);
+  CHECK_LE(rho, 1.0);
+  if (rho == 1.0) {
+    // The minibatch replaces the model.
+    std::fill(topic_distributions_.begin(), topic_distributions_.end(), 0);
+    std::fill(global_distribution_.begin(), global_distribution_.end(), 0);
+    scale_ = 1;
+  } else {
+    scale_ *= 1 - rho;
+    if (scale_ < kMinScale) {
+      Rescale();
+    }
+  }
+  const double step = rho * weight / scale_;
+  for (int i = 0; i < words.size(); ++i) {
+    const TopicCountDistribution& source =
+        minibatch_model.GetWordTopicDistribution(i);
+    double* destination =
+        &topic_distributions_[static_cast<int64>(words[i]) * num_topics_];
+    for (int k = 0; k < num_topics_; ++k) {
+      destination[k] += step * source[k];
+    }
+  }
+  const TopicCountDistribution& source =
+      minibatch_model.GetGlobalTopicDistribution();
+  for (int k = 0; k < num_topics_; ++k) {
+    global_distribution_[k] += step * source[k];
+  }
+}
+
+void LDAOnlineModel::Rescale() {
+  for (int64 i = 0; i < topic_distributions_.size(); ++i) {
+    topic_distributions_[i] *= scale_;
+  }
+  for (int k = 0; k < num_topics_; ++k) {
+    global_distribution_[k] *= scale_;
+  }
+  scale_ = 1;
+}
+
+void LDAOnlineModel::AppendAsString(const map<string, int>& word_index_map,
+                                    std::ostream& out) const {
+  CHECK_EQ(num_words(), word_index_map.size());
+  vector<string> index_word_map(word_index_map.size());
+  for (map<string, int>::const_iterator iter = word_index_map.begin();
+       iter != word_index_map.end(); ++iter) {
+    index_word_map[iter->second] = iter->first;
+  }
+  for (int i = 0; i < index_word_map.size(); ++i) {
+    out << index_word_map[i] << "\t";
+    for (int k = 0; k < num_topics_; ++k) {
+      out << GetWordTopic(i, k) << ((k < num_topics_ - 1) ? " " : "\n");
+    }
+  }
+}
+
+LDAOnlineSampler::LDAOnlineSampler(double alpha, double beta,
+                                   const LDAOnlineModel* model)
+    : alpha_(alpha), beta_(beta), model_(model), minibatch_model_(NULL) {
+  CHECK_LT(0.0, alpha);
+  CHECK_LT(0.0, beta);
+  CHECK(model != NULL);
+}
+
+LDAOnlineSampler::~LDAOnlineSampler() {
+  delete minibatch_model_;
+}
+
+void LDAOnlineSampler::StartMinibatch(const LDACorpus& minibatch,
+                                      const vector<int>& words) {
+  delete minibatch_model_;
+  minibatch_model_ = new LDAModel(model_->num_topics(), words.size());
+  words_ = words;
+  for (list<LDADocument*>::const_iterator iter = minibatch.begin();
+       iter != minibatch.end();
+       ++iter) {
+    for (LDADocument::WordOccurrenceIterator iter2(*iter);
+         !iter2.Done();
+         iter2.Next()) {
+      minibatch_model_->IncrementTopic(iter2.Word(), iter2.Topic(), 1);
+    }
+  }
+}
+
+void LDAOnlineSampler::DoIteration(LDACorpus* minibatch) {
+  const int num_topics = model_->num_topics();
+  const double vocab_beta = model_->num_words() * beta_;
+  const TopicCountDistribution& global_distribution =
+      minibatch_model_->GetGlobalTopicDistribution();
+  vector<double> new_topic_distribution(num_topics);
+  for (list<LDADocument*>::iterator iter = minibatch->begin();
+       iter != minibatch->end();
+       ++iter) {
+    LDADocument* document = *iter;
+    const vector<int64>& document_distribution =
+        document->topic_distribution();
+    for (LDADocument::WordOccurrenceIterator iterator(document);
+         !iterator.Done();
+         iterator.Next()) {
+      const int word = iterator.Word();
+      const int model_word = words_[word];
+      const int current_topic = iterator.Topic();
+      const TopicCountDistribution& word_distribution =
+          minibatch_model_->GetWordTopicDistribution(word);
+      for (int k = 0; k < num_topics; ++k) {
+        // Unassigns the current occurrence from its topic.
+        int adjustment = k == current_topic ? -1 : 0;
+        new_topic_distribution[k] =
+            (document_distribution[k] + adjustment + alpha_) *
+            (model_->GetWordTopic(model_word, k) +
+             word_distribution[k] + adjustment + beta_) /
+            (model_->GetGlobalTopic(k) +
+             global_distribution[k] + adjustment + vocab_beta);
+      }
+      int new_topic = GetAccumulativeSample(new_topic_distribution);
+      minibatch_model_->ReassignTopic(word, current_topic, new_topic, 1);
+      iterator.SetTopic(new_topic);
+    }
+  }
+}
+
+// Computes log P(d) = sum_w log sum_z P(w|z)P(z|d) like
+// LDASampler::LogLikelihood, with P(w|z) from the model plus the
+// minibatch.
+double LDAOnlineSampler::LogLikelihood(LDADocument* document) const {
+  const int num_topics = model_->num_topics();
+  const double vocab_beta = model_->num_words() * beta_;
+  const vector<int64>& document_distribution = document->topic_distribution();
+  int64 document_length = 0;
+  for (int k = 0; k < num_topics; ++k) {
+    document_length += document_distribution[k];
+  }
+  const TopicCountDistribution& global_distribution =
+      minibatch_model_->GetGlobalTopicDistribution();
+  double log_likelihood = 0;
+  for (LDADocument::WordOccurrenceIterator iterator(document);
+       !iterator.Done();
+       iterator.Next()) {
+    const int word = iterator.Word();
+    const TopicCountDistribution& word_distribution =
+        minibatch_model_->GetWordTopicDistribution(word);
+    double prob_word = 0;
+    for (int k = 0; k < num_topics; ++k) {
+      prob_word +=
+          (model_->GetWordTopic(words_[word], k) + word_distribution[k] +
+           beta_) /
+          (model_->GetGlobalTopic(k) + global_distribution[k] + vocab_beta) *
+          (document_distribution[k] + alpha_) /
+          (document_length + alpha_ * num_topics);
+    }
+    log_likelihood += log(prob_word);
+  }
+  return log_likelihood;
+}
+
+}  // namespace learning_lda
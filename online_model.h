@@ -0,0 +1,119 @@
+// Copyright 2008 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef _OPENSOURCE_GLDA_ONLINE_MODEL_H__
+#define _OPENSOURCE_GLDA_ONLINE_MODEL_H__
+
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "common.h"
+#include "document.h"
+#include "model.h"
+
+namespace learning_lda {
+
+// LDAOnlineModel is the real-valued model lambda of online (streaming
+// Gibbs) training.  After every minibatch B of the stream, lambda moves
+// towards the word-topic counts n_B of the minibatch scaled to the size
+// of the corpus:
+//   lambda <- (1 - rho) * lambda + rho * weight * n_B
+// with a decaying step size rho and weight = D / |B|.  The words of the
+// stream are added as they appear.
+//
+// lambda is stored as scale_ times the values in memory, so that the
+// (1 - rho) decay is a single multiplication and an update only touches
+// the words of the minibatch.
+class LDAOnlineModel {
+ public:
+  explicit LDAOnlineModel(int num_topics);
+  ~LDAOnlineModel() {}
+
+  // Adds zero words until the model has num_words words.
+  void Resize(int num_words);
+
+  // Moves the model towards minibatch_model, whose word i is word
+  // words[i] of this model, as above.
+  void Update(const LDAModel& minibatch_model, const vector<int>& words,
+              double rho, double weight);
+
+  // Returns lambda of word and topic.
+  double GetWordTopic(int word, int topic) const {
+    return topic_distributions_[static_cast<int64>(word) * num_topics_ +
+                                topic] * scale_;
+  }
+
+  // Returns the sum of lambda over the words for topic.
+  double GetGlobalTopic(int topic) const {
+    return global_distribution_[topic] * scale_;
+  }
+
+  int num_topics() const { return num_topics_; }
+  int num_words() const {
+    return topic_distributions_.size() / num_topics_;
+  }
+
+  // Writes the model in the format of LDAModel::AppendAsString.
+  void AppendAsString(const map<string, int>& word_index_map,
+                      std::ostream& out) const;
+
+ private:
+  // Multiplies the values in memory by scale_ and resets scale_ to 1.
+  void Rescale();
+
+  int num_topics_;
+  double scale_;
+  vector<double> topic_distributions_;
+  vector<double> global_distribution_;
+};
+
+// LDAOnlineSampler performs Gibbs sampling of a minibatch against an
+// LDAOnlineModel plus the counts of the minibatch itself:
+//   P(z=k) ~ (n_dk + alpha) * (lambda_wk + n_wk + beta) /
+//            (lambda_k + n_k + V * beta)
+// The documents of a minibatch index their words locally, and words[i]
+// is the model word of local word i, so the minibatch counts take memory
+// only for the words of the minibatch.
+class LDAOnlineSampler {
+ public:
+  LDAOnlineSampler(double alpha, double beta, const LDAOnlineModel* model);
+  ~LDAOnlineSampler();
+
+  // Starts a minibatch whose documents have been initialized with topics,
+  // and counts them into minibatch_model().
+  void StartMinibatch(const LDACorpus& minibatch, const vector<int>& words);
+
+  // Performs one round of Gibbs sampling on the documents of the
+  // minibatch, updating minibatch_model().
+  void DoIteration(LDACorpus* minibatch);
+
+  // Computes the log likelihood of a document of the minibatch.
+  double LogLikelihood(LDADocument* document) const;
+
+  const LDAModel& minibatch_model() const { return *minibatch_model_; }
+  const vector<int>& words() const { return words_; }
+
+ private:
+  const double alpha_;
+  const double beta_;
+  const LDAOnlineModel* model_;
+  LDAModel* minibatch_model_;
+  vector<int> words_;
+};
+
+}  // namespace learning_lda
+
+#endif  // _OPENSOURCE_GLDA_ONLINE_MODEL_H__
@@ -0,0 +1,267 @@
+// Copyright 2008 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "out_of_core_corpus.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <fstream>
+#include <sstream>
+
+namespace learning_lda {
+
+namespace {
+
+void AppendInt32(int32 value, string* out) {
+  out->append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+// Reads or writes size bytes at offset, retrying short transfers.
+void TransferAll(int fd, char* data, int64 size, int64 offset, bool write) {
+  while (size > 0) {
+    ssize_t n = write ? pwrite(fd, data, size, offset) :
+        pread(fd, data, size, offset);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    CHECK_LT(0, n);
+    data += n;
+    size -= n;
+    offset += n;
+  }
+}
+
+}  // namespace
+
+OutOfCoreCorpus::OutOfCoreCorpus(const string& training_data_file,
+                                 const string& path, int num_topics,
+                                 int64 block_bytes,
+                                 const VocabularyFilter& vocabulary_filter,
+                                 map<string, int>* word_index_map)
+    : num_topics_(num_topics),
+      path_(path),
+      num_documents_(0),
+      file_size_(0),
+      next_block_(0),
+      io_wait_time_(0),
+      num_enqueued_(0),
+      num_done_(0),
+      stopping_(false) {
+  CHECK_LT(0, block_bytes);
+  // The file is removed in the end, so it must not be an existing one.
+  fd_ = open(path.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+  CHECK_LE(0, fd_);
+  word_index_map->clear();
+  std::ifstream fin(training_data_file.c_str());
+  string line;
+  string block;
+  int64 max_block_size = 0;
+  while (true) {
+    bool more = static_cast<bool>(getline(fin, line));
+    if (more && line.size() > 0 &&  // Skip empty lines.
+        line[0] != '\r' &&          // Skip empty lines.
+        line[0] != '\n' &&          // Skip empty lines.
+        line[0] != '#') {           // Skip comment lines.
+      std::istringstream ss(line);
+      string document;
+      int32 num_words = 0;
+      string word;
+      string model_word;
+      int count;
+      while (ss >> word >> count) {
+        if (!vocabulary_filter.Map(word, &model_word)) {
+          continue;
+        }
+        int word_index;
+        map<string, int>::const_iterator iter =
+            word_index_map->find(model_word);
+        if (iter == word_index_map->end()) {
+          word_index = word_index_map->size();
+          (*word_index_map)[model_word] = word_index;
+        } else {
+          word_index = iter->second;
+        }
+        AppendInt32(word_index, &document);
+        AppendInt32(count, &document);
+        for (int i = 0; i < count; ++i) {
+          AppendInt32(RandInt(num_topics), &document);
+        }
+        ++num_words;
+      }
+      AppendInt32(num_words, &block);
+      block.append(document);
+      ++num_documents_;
+    }
+    if (!block.empty() && (!more || block.size() >= block_bytes)) {
+      Block written = { file_size_, static_cast<int64>(block.size()) };
+      TransferAll(fd_, &block[0], block.size(), file_size_, true);
+      blocks_.push_back(written);
+      file_size_ += block.size();
+      max_block_size = std::max(max_block_size,
+                                static_cast<int64>(block.size()));
+      block.clear();
+    }
+    if (!more) {
+      break;
+    }
+  }
+  for (int i = 0; i < 3; ++i) {
+    buffers_[i].resize(max_block_size);
+  }
+  read_sequences_.resize(blocks_.size(), 0);
+  pthread_mutex_init(&mutex_, NULL);
+  pthread_cond_init(&cond_, NULL);
+  CHECK_EQ(0, pthread_create(&io_thread_, NULL, RunIOThread, this));
+}
+
+OutOfCoreCorpus::~OutOfCoreCorpus() {
+  pthread_mutex_lock(&mutex_);
+  stopping_ = true;
+  pthread_cond_broadcast(&cond_);
+  pthread_mutex_unlock(&mutex_);
+  pthread_join(io_thread_, NULL);
+  pthread_cond_destroy(&cond_);
+  pthread_mutex_destroy(&mutex_);
+  for (int i = 0; i < 3; ++i) {
+    for (LDACorpus::iterator iter = documents_[i].begin();
+         iter != documents_[i].end(); ++iter) {
+      delete *iter;
+    }
+  }
+  close(fd_);
+  unlink(path_.c_str());
+}
+
+void* OutOfCoreCorpus::RunIOThread(void* arg) {
+  OutOfCoreCorpus* corpus = static_cast<OutOfCoreCorpus*>(arg);
+  pthread_mutex_lock(&corpus->mutex_);
+  while (true) {
+    while (corpus->requests_.empty() && !corpus->stopping_) {
+      pthread_cond_wait(&corpus->cond_, &corpus->mutex_);
+    }
+    if (corpus->requests_.empty()) {
+      break;
+    }
+    Request request = corpus->requests_.front();
+    pthread_mutex_unlock(&corpus->mutex_);
+    const Block& block = corpus->blocks_[request.block];
+    if (request.write) {
+      corpus->SerializeBlock(request.block);
+    }
+    TransferAll(corpus->fd_, &(*corpus->buffer(request.block))[0],
+                block.size, block.offset, request.write);
+    if (!request.write) {
+      corpus->ParseBlock(request.block);
+    }
+    pthread_mutex_lock(&corpus->mutex_);
+    corpus->requests_.pop_front();
+    ++corpus->num_done_;
+    pthread_cond_broadcast(&corpus->cond_);
+  }
+  pthread_mutex_unlock(&corpus->mutex_);
+  return NULL;
+}
+
+int64 OutOfCoreCorpus::Enqueue(int block, bool write) {
+  Request request = { block, write };
+  pthread_mutex_lock(&mutex_);
+  requests_.push_back(request);
+  int64 sequence = ++num_enqueued_;
+  pthread_cond_broadcast(&cond_);
+  pthread_mutex_unlock(&mutex_);
+  return sequence;
+}
+
+void OutOfCoreCorpus::Wait(int64 sequence) {
+  double start = WallTime();
+  pthread_mutex_lock(&mutex_);
+  while (num_done_ < sequence) {
+    pthread_cond_wait(&cond_, &mutex_);
+  }
+  pthread_mutex_unlock(&mutex_);
+  io_wait_time_ += WallTime() - start;
+}
+
+void OutOfCoreCorpus::StartSweep() {
+  for (int i = 0; i < 3; ++i) {
+    CHECK(documents_[i].empty());
+  }
+  next_block_ = 0;
+  io_wait_time_ = 0;
+  if (!blocks_.empty()) {
+    read_sequences_[0] = Enqueue(0, false);
+  }
+}
+
+LDACorpus* OutOfCoreCorpus::NextBlock() {
+  const int b = next_block_;
+  if (b > 0) {
+    Enqueue(b - 1, true);
+  }
+  if (b == blocks_.size()) {
+    Wait(num_enqueued_);
+    return NULL;
+  }
+  // The buffer and documents of block b + 1 are the ones of block
+  // b - 2, whose write was queued before.
+  if (b + 1 < blocks_.size()) {
+    read_sequences_[b + 1] = Enqueue(b + 1, false);
+  }
+  Wait(read_sequences_[b]);
+  ++next_block_;
+  return documents(b);
+}
+
+void OutOfCoreCorpus::ParseBlock(int b) {
+  const int32* data = reinterpret_cast<const int32*>(&(*buffer(b))[0]);
+  const int32* end = data + blocks_[b].size / sizeof(int32);
+  vector<int32> topics;
+  while (data < end) {
+    DocumentWordTopicsPB document;
+    int32 num_words = *data++;
+    for (int i = 0; i < num_words; ++i) {
+      int32 word = *data++;
+      int32 count = *data++;
+      topics.assign(data, data + count);
+      data += count;
+      document.add_wordtopics("", word, topics);
+    }
+    documents(b)->push_back(new LDADocument(document, num_topics_));
+  }
+}
+
+void OutOfCoreCorpus::SerializeBlock(int b) {
+  int32* data = reinterpret_cast<int32*>(&(*buffer(b))[0]);
+  LDACorpus* documents = this->documents(b);
+  for (LDACorpus::iterator iter = documents->begin();
+       iter != documents->end(); ++iter) {
+    const DocumentWordTopicsPB& topics = (*iter)->topics();
+    int32 num_words = *data++;
+    CHECK_EQ(num_words, topics.words_size());
+    for (int i = 0; i < num_words; ++i) {
+      data += 2;
+      for (int j = topics.word_last_topic_index(i) -
+               topics.wordtopics_count(i) + 1;
+           j <= topics.word_last_topic_index(i); ++j) {
+        *data++ = topics.wordtopics(j);
+      }
+    }
+    delete *iter;
+  }
+  documents->clear();
+}
+
+}  // namespace learning_lda
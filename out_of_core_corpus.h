@@ -0,0 +1,130 @@
+// Copyright 2008 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef _OPENSOURCE_GLDA_OUT_OF_CORE_CORPUS_H__
+#define _OPENSOURCE_GLDA_OUT_OF_CORE_CORPUS_H__
+
+#include <pthread.h>
+
+#include <deque>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "common.h"
+#include "document.h"
+#include "vocabulary.h"
+
+namespace learning_lda {
+
+// OutOfCoreCorpus keeps a training corpus and its topic assignments in a
+// binary file instead of memory, for corpora larger than RAM.  The file
+// is swept block by block: while the documents of a block are sampled,
+// a background thread prefetches the next block by pread and parses its
+// documents, and copies the topics of the previous one into its buffer
+// and writes them back by pwrite, so at most three blocks are in
+// memory.  Every document is stored as its number of
+// unique words followed, for each word, by the word index, its count
+// and the topics of its occurrences, all int32.
+//
+// This class is not thread-safe.
+class OutOfCoreCorpus {
+ public:
+  // Converts the documents of training_data_file, in the training data
+  // format, into the binary file path with random topics, in blocks of
+  // about block_bytes bytes, with its words mapped by vocabulary_filter.
+  // Fills word_index_map with the vocabulary.  path must not exist.
+  OutOfCoreCorpus(const string& training_data_file, const string& path,
+                  int num_topics, int64 block_bytes,
+                  const VocabularyFilter& vocabulary_filter,
+                  map<string, int>* word_index_map);
+
+  // Stops the background thread and removes the file.
+  ~OutOfCoreCorpus();
+
+  // Starts a sweep over the blocks, prefetching the first one.
+  void StartSweep();
+
+  // Returns the documents of the next block of the sweep, or NULL after
+  // the last block.  The documents of the previously returned block,
+  // whose topics may have been changed, are written back and deleted.
+  // Returning NULL waits for all writes.
+  LDACorpus* NextBlock();
+
+  int num_blocks() const { return blocks_.size(); }
+  int64 num_documents() const { return num_documents_; }
+  int64 file_size() const { return file_size_; }
+
+  // Returns the seconds NextBlock spent waiting for the background
+  // thread, including its parsing of documents, in the current sweep.
+  double io_wait_time() const { return io_wait_time_; }
+
+ private:
+  struct Block {
+    int64 offset;
+    int64 size;
+  };
+
+  // A read or write of a block by the background thread.
+  struct Request {
+    int block;
+    bool write;
+  };
+
+  static void* RunIOThread(void* arg);
+
+  // Queues a request and returns its sequence number.
+  int64 Enqueue(int block, bool write);
+
+  // Waits until the request of sequence number sequence is done.
+  void Wait(int64 sequence);
+
+  // The buffer holding block b in memory, and its documents.
+  vector<char>* buffer(int b) { return &buffers_[b % 3]; }
+  LDACorpus* documents(int b) { return &documents_[b % 3]; }
+
+  // Creates the documents of block b from its buffer.  Called by the
+  // background thread.
+  void ParseBlock(int b);
+
+  // Copies the topics of the documents of block b into its buffer and
+  // deletes the documents.  Called by the background thread.
+  void SerializeBlock(int b);
+
+  const int num_topics_;
+  string path_;
+  int fd_;
+  vector<Block> blocks_;
+  int64 num_documents_;
+  int64 file_size_;
+
+  vector<char> buffers_[3];
+  LDACorpus documents_[3];
+  // The block NextBlock returns next.
+  int next_block_;
+  vector<int64> read_sequences_;
+  double io_wait_time_;
+
+  pthread_t io_thread_;
+  pthread_mutex_t mutex_;
+  pthread_cond_t cond_;
+  std::deque<Request> requests_;
+  int64 num_enqueued_;
+  int64 num_done_;
+  bool stopping_;
+};
+
+}  // namespace learning_lda
+
+#endif  // _OPENSOURCE_GLDA_OUT_OF_CORE_CORPUS_H__
@@ -0,0 +1,629 @@
+// Copyright 2008 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "parallel_model.h"
+
+#include <limits.h>
+
+#include <algorithm>
+
+#include "delta_codec.h"
+#include "numa_placement.h"
+
+namespace learning_lda {
+
+namespace {
+
+// The number of counts reduced by one MPI call.
+const int kMaxDataCount = 1 << 22;
+
+}  // namespace
+
+void AllReduceTopicDistribution(int64* buf, int64 count, MPI_Comm comm) {
+  for (int64 offset = 0; offset < count; offset += kMaxDataCount) {
+    MPI_Allreduce(MPI_IN_PLACE, buf + offset,
+                  std::min(static_cast<int64>(kMaxDataCount),
+                           count - offset),
+                  MPI_LONG_LONG, MPI_SUM, comm);
+  }
+}
+
+WordOccurrenceIndex::WordOccurrenceIndex(const LDACorpus& corpus,
+                                         int num_words)
+    : word_begin_(num_words + 1, 0) {
+  for (list<LDADocument*>::const_iterator iter = corpus.begin();
+       iter != corpus.end();
+       ++iter) {
+    const DocumentWordTopicsPB& topics = (*iter)->topics();
+    for (int i = 0; i < topics.words_size(); ++i) {
+      ++word_begin_[topics.word(i) + 1];
+    }
+  }
+  for (int w = 0; w < num_words; ++w) {
+    word_begin_[w + 1] += word_begin_[w];
+  }
+  groups_.resize(word_begin_[num_words]);
+  vector<int64> next(word_begin_.begin(), word_begin_.end() - 1);
+  for (list<LDADocument*>::const_iterator iter = corpus.begin();
+       iter != corpus.end();
+       ++iter) {
+    const DocumentWordTopicsPB& topics = (*iter)->topics();
+    for (int i = 0; i < topics.words_size(); ++i) {
+      groups_[next[topics.word(i)]++] = std::make_pair(*iter, i);
+    }
+  }
+}
+
+ParallelLDAModel::ParallelLDAModel(int num_topics, int num_words,
+                                   bool node_shared)
+    : node_shared_(node_shared),
+      node_comm_(MPI_COMM_NULL),
+      leader_comm_(MPI_COMM_NULL),
+      node_rank_(0),
+      node_size_(1),
+      bytes_communicated_(0),
+      overlap_ratio_(0),
+      encoded_bytes_(0),
+      encode_time_(0),
+      decode_time_(0) {
+  if (!node_shared) {
+    Initialize(num_topics, num_words);
+    return;
+  }
+  MPI_Comm_split_type(MPI_COMM_WORLD, MPI_COMM_TYPE_SHARED, 0,
+                      MPI_INFO_NULL, &node_comm_);
+  MPI_Comm_rank(node_comm_, &node_rank_);
+  MPI_Comm_size(node_comm_, &node_size_);
+  MPI_Comm_split(MPI_COMM_WORLD, node_rank_ == 0 ? 0 : MPI_UNDEFINED, 0,
+                 &leader_comm_);
+  // The leader allocates the whole model and the others map it.
+  const int64 size = static_cast<int64>(num_topics) * (num_words + 1);
+  int64* memory = NULL;
+  MPI_Win_allocate_shared(node_rank_ == 0 ? size * sizeof(int64) : 0,
+                          sizeof(int64), MPI_INFO_NULL, node_comm_,
+                          &memory, &window_);
+  if (node_rank_ != 0) {
+    MPI_Aint window_size;
+    int displacement_unit;
+    MPI_Win_shared_query(window_, 0, &window_size, &displacement_unit,
+                         &memory);
+  }
+  MPI_Win_lock_all(MPI_MODE_NOCHECK, window_);
+  if (node_rank_ == 0) {
+    AdviseHugePages(memory, size * sizeof(int64));
+    std::fill(memory, memory + size, 0);
+  }
+  Initialize(num_topics, num_words, memory);
+  set_concurrent(node_size_ > 1);
+  NodeBarrier();
+}
+
+void ParallelLDAModel::NodeBarrier() {
+  MPI_Win_sync(window_);
+  MPI_Barrier(node_comm_);
+  MPI_Win_sync(window_);
+}
+
+void ParallelLDAModel::ComputeAndAllReduce(const LDACorpus& corpus) {
+  for (list<LDADocument*>::const_iterator iter = corpus.begin();
+       iter != corpus.end();
+       ++iter) {
+    LDADocument* document = *iter;
+    for (LDADocument::WordOccurrenceIterator iter2(document);
+         !iter2.Done(); iter2.Next()) {
+      IncrementTopic(iter2.Word(), iter2.Topic(), 1);
+    }
+  }
+  if (node_shared_) {
+    NodeBarrier();
+    if (node_rank_ == 0) {
+      AllReduceTopicDistribution(memory_, memory_size_, leader_comm_);
+    }
+    NodeBarrier();
+  } else {
+    AllReduceTopicDistribution(memory_, memory_size_);
+  }
+  bytes_communicated_ = dense_bytes();
+}
+
+ParallelLDAModel::~ParallelLDAModel() {
+  CHECK(in_flight_.empty());
+  for (int i = 0; i < free_reductions_.size(); ++i) {
+    MPI_Comm_free(&free_reductions_[i]->comm);
+    delete free_reductions_[i];
+  }
+  if (node_shared_) {
+    MPI_Win_unlock_all(window_);
+    MPI_Win_free(&window_);
+    if (leader_comm_ != MPI_COMM_NULL) {
+      MPI_Comm_free(&leader_comm_);
+    }
+    MPI_Comm_free(&node_comm_);
+  }
+}
+
+void ParallelLDAModel::AddReducedDelta(int64* reduced,
+                                       int begin_word, int end_word,
+                                       const LDAModelDelta& delta,
+                                       int64 begin_entry, int64 end_entry) {
+  const int num_topics = this->num_topics();
+  const int64 first_cell = static_cast<int64>(begin_word) * num_topics;
+  const vector<int64>& cells = delta.cells();
+  const vector<int32>& counts = delta.counts();
+  // Our own changes are already in the model.
+  for (int64 i = begin_entry; i < end_entry; ++i) {
+    reduced[cells[i] - first_cell] -= counts[i];
+  }
+  TopicCountDistribution global_distribution = GetGlobalTopicDistribution();
+  int64* model = memory_ + first_cell;
+  const int64 end = static_cast<int64>(end_word - begin_word) * num_topics;
+  for (int64 offset = 0; offset < end; offset += num_topics) {
+    for (int k = 0; k < num_topics; ++k) {
+      if (reduced[offset + k] != 0) {
+        model[offset + k] += reduced[offset + k];
+        global_distribution[k] += reduced[offset + k];
+        reduced[offset + k] = 0;
+      }
+    }
+  }
+}
+
+void ParallelLDAModel::ChunkedAllReduce(LDAModelDelta* delta,
+                                        MPI_Comm comm) {
+  const int num_topics = this->num_topics();
+  const int num_words = this->num_words();
+  const int words_per_chunk = std::max(1, kMaxDataCount / num_topics);
+  const int64 chunk_size =
+      static_cast<int64>(std::min(words_per_chunk, num_words)) * num_topics;
+  if (chunk_buffer_.size() != chunk_size) {
+    chunk_buffer_.assign(chunk_size, 0);
+  }
+  // Sorted by cell, the changes of every range are contiguous.
+  delta->Compact();
+  const vector<int64>& cells = delta->cells();
+  const vector<int32>& counts = delta->counts();
+  int64 entry = 0;
+  for (int begin_word = 0; begin_word < num_words;
+       begin_word += words_per_chunk) {
+    const int end_word =
+        begin_word + std::min(words_per_chunk, num_words - begin_word);
+    const int64 first_cell = static_cast<int64>(begin_word) * num_topics;
+    const int64 end_cell = static_cast<int64>(end_word) * num_topics;
+    const int64 begin_entry = entry;
+    for (; entry < cells.size() && cells[entry] < end_cell; ++entry) {
+      chunk_buffer_[cells[entry] - first_cell] += counts[entry];
+    }
+    AllReduceTopicDistribution(&chunk_buffer_[0], end_cell - first_cell,
+                               comm);
+    AddReducedDelta(&chunk_buffer_[0], begin_word, end_word, *delta,
+                    begin_entry, entry);
+  }
+}
+
+void ParallelLDAModel::DenseAllReduce(LDAModelDelta* delta) {
+  if (node_shared_) {
+    NodeDenseAllReduce(delta);
+    return;
+  }
+  ChunkedAllReduce(delta, MPI_COMM_WORLD);
+  bytes_communicated_ = dense_bytes();
+  delta->clear();
+}
+
+void ParallelLDAModel::StartDenseRange(DenseReduction* reduction,
+                                       int begin_word) {
+  const int num_topics = this->num_topics();
+  const int words_per_chunk = std::max(1, kMaxDataCount / num_topics);
+  reduction->begin_word = begin_word;
+  reduction->end_word =
+      begin_word + std::min(words_per_chunk, num_words() - begin_word);
+  const int64 first_cell = static_cast<int64>(begin_word) * num_topics;
+  const int64 end_cell =
+      static_cast<int64>(reduction->end_word) * num_topics;
+  const vector<int64>& cells = reduction->delta.cells();
+  const vector<int32>& counts = reduction->delta.counts();
+  int64 entry = reduction->end_entry;
+  reduction->begin_entry = entry;
+  for (; entry < cells.size() && cells[entry] < end_cell; ++entry) {
+    reduction->buffer[cells[entry] - first_cell] += counts[entry];
+  }
+  reduction->end_entry = entry;
+  MPI_Iallreduce(MPI_IN_PLACE, &reduction->buffer[0],
+                 end_cell - first_cell, MPI_LONG_LONG, MPI_SUM,
+                 reduction->comm, &reduction->request);
+}
+
+void ParallelLDAModel::StartDenseAllReduce(LDAModelDelta* delta) {
+  // Lets the reductions in flight advance to their next ranges.
+  for (int i = 0; i < in_flight_.size(); ++i) {
+    DenseReduction* reduction = in_flight_[i];
+    while (reduction->end_word < num_words()) {
+      int done;
+      MPI_Test(&reduction->request, &done, MPI_STATUS_IGNORE);
+      if (!done) {
+        break;
+      }
+      AddReducedDelta(&reduction->buffer[0], reduction->begin_word,
+                      reduction->end_word, reduction->delta,
+                      reduction->begin_entry, reduction->end_entry);
+      StartDenseRange(reduction, reduction->end_word);
+    }
+  }
+  DenseReduction* reduction;
+  if (free_reductions_.empty()) {
+    reduction = new DenseReduction(num_topics());
+    MPI_Comm_dup(MPI_COMM_WORLD, &reduction->comm);
+  } else {
+    reduction = free_reductions_.back();
+    free_reductions_.pop_back();
+  }
+  const int words_per_chunk = std::max(1, kMaxDataCount / num_topics());
+  const int64 chunk_size =
+      static_cast<int64>(std::min(words_per_chunk, num_words())) *
+      num_topics();
+  if (reduction->buffer.size() != chunk_size) {
+    reduction->buffer.assign(chunk_size, 0);
+  }
+  // Sorted by cell, the changes of every range are contiguous.
+  delta->Compact();
+  reduction->delta.mutable_cells()->swap(*delta->mutable_cells());
+  reduction->delta.mutable_counts()->swap(*delta->mutable_counts());
+  delta->clear();
+  reduction->end_entry = 0;
+  StartDenseRange(reduction, 0);
+  in_flight_.push_back(reduction);
+  bytes_communicated_ =
+      static_cast<int64>(num_words()) * num_topics() * sizeof(int64);
+}
+
+bool ParallelLDAModel::FinishDenseAllReduce() {
+  if (in_flight_.empty()) {
+    return false;
+  }
+  DenseReduction* reduction = in_flight_.front();
+  in_flight_.pop_front();
+  while (true) {
+    MPI_Wait(&reduction->request, MPI_STATUS_IGNORE);
+    AddReducedDelta(&reduction->buffer[0], reduction->begin_word,
+                    reduction->end_word, reduction->delta,
+                    reduction->begin_entry, reduction->end_entry);
+    if (reduction->end_word == num_words()) {
+      break;
+    }
+    StartDenseRange(reduction, reduction->end_word);
+  }
+  reduction->delta.clear();
+  free_reductions_.push_back(reduction);
+  return true;
+}
+
+void ParallelLDAModel::SampleAndAllReduce(const WordOccurrenceIndex& index,
+                                          LDASampler* sampler,
+                                          LDAModelDelta* delta,
+                                          int num_chunks) {
+  // Chunks are also kept within the count limit of
+  // AllReduceTopicDistribution.
+  const int num_topics = this->num_topics();
+  const int num_words = this->num_words();
+  const int64 size = static_cast<int64>(num_words) * num_topics;
+  if (delta_buffer_.size() != size) {
+    delta_buffer_.assign(size, 0);
+  }
+  int words_per_chunk = std::max(1, std::min(
+      (num_words + num_chunks - 1) / num_chunks,
+      kMaxDataCount / num_topics));
+  vector<int> chunk_begin;
+  for (int w = 0; w < num_words; w += words_per_chunk) {
+    chunk_begin.push_back(w);
+  }
+  chunk_begin.push_back(num_words);
+  const int chunks = chunk_begin.size() - 1;
+  // The range of delta entries recorded while sampling each chunk.  As
+  // the chunks are sampled in word order, the entries of the chunks done
+  // stay in place when delta compacts itself.
+  vector<int64> entry_begin(chunks + 1, 0);
+  vector<MPI_Request> requests(chunks, MPI_REQUEST_NULL);
+  vector<int> completed(chunks);
+
+  delta->clear();
+  double first_start = 0;
+  int num_completed = 0;
+  for (int c = 0; c < chunks; ++c) {
+    for (int w = chunk_begin[c]; w < chunk_begin[c + 1]; ++w) {
+      for (int64 i = index.begin(w); i < index.begin(w + 1); ++i) {
+        LDADocument* document = index.document(i);
+        const DocumentWordTopicsPB& topics = document->topics();
+        int word_index = index.word_index(i);
+        for (int j = topics.word_last_topic_index(word_index) -
+                 topics.wordtopics_count(word_index) + 1;
+             j <= topics.word_last_topic_index(word_index); ++j) {
+          sampler->SampleNewTopicForWordOccurrence(document, w, j, true);
+        }
+      }
+      // Lets MPI progress the reductions in flight.
+      if (c > 0 && num_completed < c) {
+        int count = 0;
+        MPI_Testsome(c, &requests[0], &count, &completed[0],
+                     MPI_STATUSES_IGNORE);
+        for (int i = 0; i < count; ++i) {
+          int done = completed[i];
+          AddReducedDelta(
+              &delta_buffer_[static_cast<int64>(chunk_begin[done]) *
+                             num_topics],
+              chunk_begin[done], chunk_begin[done + 1], *delta,
+              entry_begin[done], entry_begin[done + 1]);
+        }
+        num_completed += count;
+      }
+    }
+    delta->Compact();
+    entry_begin[c + 1] = delta->size();
+    const vector<int64>& cells = delta->cells();
+    const vector<int32>& counts = delta->counts();
+    for (int64 i = entry_begin[c]; i < entry_begin[c + 1]; ++i) {
+      delta_buffer_[cells[i]] += counts[i];
+    }
+    if (c == 0) {
+      first_start = MPI_Wtime();
+    }
+    int64 offset = static_cast<int64>(chunk_begin[c]) * num_topics;
+    MPI_Iallreduce(MPI_IN_PLACE, &delta_buffer_[offset],
+                   (chunk_begin[c + 1] - chunk_begin[c]) * num_topics,
+                   MPI_LONG_LONG, MPI_SUM, MPI_COMM_WORLD, &requests[c]);
+  }
+
+  double wait_start = MPI_Wtime();
+  while (num_completed < chunks) {
+    int count = 0;
+    MPI_Waitsome(chunks, &requests[0], &count, &completed[0],
+                 MPI_STATUSES_IGNORE);
+    for (int i = 0; i < count; ++i) {
+      int done = completed[i];
+      AddReducedDelta(
+          &delta_buffer_[static_cast<int64>(chunk_begin[done]) * num_topics],
+          chunk_begin[done], chunk_begin[done + 1], *delta,
+          entry_begin[done], entry_begin[done + 1]);
+    }
+    num_completed += count;
+  }
+  double wait_end = MPI_Wtime();
+  double in_flight = wait_end - first_start;
+  overlap_ratio_ = in_flight > 0 ?
+      1 - (wait_end - wait_start) / in_flight : 0;
+  bytes_communicated_ = size * sizeof(int64);
+  delta->clear();
+}
+
+void ParallelLDAModel::SparseAllReduce(LDAModelDelta* delta) {
+  int myid, pnum;
+  MPI_Comm_rank(MPI_COMM_WORLD, &myid);
+  MPI_Comm_size(MPI_COMM_WORLD, &pnum);
+  delta->Compact();
+
+  int local_size = delta->size();
+  vector<int> sizes(pnum);
+  MPI_Allgather(&local_size, 1, MPI_INT, &sizes[0], 1, MPI_INT,
+                MPI_COMM_WORLD);
+  vector<int> displacements(pnum, 0);
+  for (int i = 1; i < pnum; ++i) {
+    displacements[i] = displacements[i - 1] + sizes[i - 1];
+  }
+  int total_size = displacements[pnum - 1] + sizes[pnum - 1];
+
+  LDAModelDelta all_deltas(num_topics());
+  all_deltas.mutable_cells()->resize(total_size);
+  all_deltas.mutable_counts()->resize(total_size);
+  if (total_size > 0) {
+    // Allgatherv does not accept a NULL buffer even for empty deltas.
+    int64 dummy_cell = 0;
+    int32 dummy_count = 0;
+    MPI_Allgatherv(local_size > 0 ? &(*delta->mutable_cells())[0] : &dummy_cell,
+                   local_size, MPI_LONG_LONG,
+                   &(*all_deltas.mutable_cells())[0], &sizes[0],
+                   &displacements[0], MPI_LONG_LONG, MPI_COMM_WORLD);
+    MPI_Allgatherv(local_size > 0 ? &(*delta->mutable_counts())[0] :
+                   &dummy_count,
+                   local_size, MPI_INT,
+                   &(*all_deltas.mutable_counts())[0], &sizes[0],
+                   &displacements[0], MPI_INT, MPI_COMM_WORLD);
+  }
+
+  // Our own changes are already in the model.
+  vector<int64>* cells = all_deltas.mutable_cells();
+  vector<int32>* counts = all_deltas.mutable_counts();
+  cells->erase(cells->begin() + displacements[myid],
+               cells->begin() + displacements[myid] + local_size);
+  counts->erase(counts->begin() + displacements[myid],
+                counts->begin() + displacements[myid] + local_size);
+  ApplyDelta(all_deltas);
+  bytes_communicated_ = static_cast<int64>(total_size - local_size) *
+      (sizeof(int64) + sizeof(int32));
+  delta->clear();
+}
+
+void ParallelLDAModel::CompressedAllReduce(LDAModelDelta* delta) {
+  int myid, pnum;
+  MPI_Comm_rank(MPI_COMM_WORLD, &myid);
+  MPI_Comm_size(MPI_COMM_WORLD, &pnum);
+  double encode_start = MPI_Wtime();
+  delta->Compact();
+  string encoded;
+  row_encodings_.assign(kNumRowEncodings, 0);
+  EncodeModelDelta(*delta, &encoded, &row_encodings_);
+  encode_time_ = MPI_Wtime() - encode_start;
+  encoded_bytes_ = encoded.size();
+
+  int local_size = encoded.size();
+  vector<int> sizes(pnum);
+  MPI_Allgather(&local_size, 1, MPI_INT, &sizes[0], 1, MPI_INT,
+                MPI_COMM_WORLD);
+  vector<int> displacements(pnum, 0);
+  for (int i = 1; i < pnum; ++i) {
+    displacements[i] = displacements[i - 1] + sizes[i - 1];
+  }
+  int total_size = displacements[pnum - 1] + sizes[pnum - 1];
+  // Every encoded delta holds at least its format byte.
+  vector<char> all_encoded(total_size);
+  MPI_Allgatherv(&encoded[0], local_size, MPI_CHAR, &all_encoded[0],
+                 &sizes[0], &displacements[0], MPI_CHAR, MPI_COMM_WORLD);
+
+  // Our own changes are already in the model.
+  double decode_start = MPI_Wtime();
+  LDAModelDelta others(num_topics());
+  for (int p = 0; p < pnum; ++p) {
+    if (p != myid) {
+      CHECK(DecodeModelDelta(&all_encoded[displacements[p]], sizes[p],
+                             &others));
+    }
+  }
+  ApplyDelta(others);
+  decode_time_ = MPI_Wtime() - decode_start;
+  bytes_communicated_ = total_size - local_size;
+  delta->clear();
+}
+
+void ParallelLDAModel::ReduceScatterAllReduce(LDAModelDelta* delta) {
+  int myid, pnum;
+  MPI_Comm_rank(MPI_COMM_WORLD, &myid);
+  MPI_Comm_size(MPI_COMM_WORLD, &pnum);
+  const int num_topics = this->num_topics();
+  const int num_words = this->num_words();
+  // The words are reduced range by range, each range within the count
+  // limit of AllReduceTopicDistribution, and every process owns an
+  // equal share of each range.
+  const int words_per_owner = std::max(1, std::min(
+      kMaxDataCount / num_topics / pnum, (num_words + pnum - 1) / pnum));
+  const int words_per_chunk = words_per_owner * pnum;
+  const int64 block_size = static_cast<int64>(words_per_owner) * num_topics;
+  if (delta_buffer_.size() != block_size * pnum) {
+    delta_buffer_.assign(block_size * pnum, 0);
+  }
+  owned_buffer_.resize(block_size);
+  // Sorted by cell, the changes of every range are contiguous.
+  delta->Compact();
+  const vector<int64>& cells = delta->cells();
+  const vector<int32>& counts = delta->counts();
+  const int64 num_cells = static_cast<int64>(num_words) * num_topics;
+  LDAModelDelta owned_delta(num_topics);
+  int64 num_chunks = 0;
+  encode_time_ = 0;
+  int64 entry = 0;
+  for (int begin_word = 0; begin_word < num_words;
+       begin_word += words_per_chunk) {
+    const int64 first_cell = static_cast<int64>(begin_word) * num_topics;
+    const int64 end_cell = std::min(first_cell + block_size * pnum,
+                                    num_cells);
+    const int64 begin_entry = entry;
+    for (; entry < cells.size() && cells[entry] < end_cell; ++entry) {
+      delta_buffer_[cells[entry] - first_cell] += counts[entry];
+    }
+    MPI_Reduce_scatter_block(&delta_buffer_[0], &owned_buffer_[0],
+                             block_size, MPI_LONG_LONG, MPI_SUM,
+                             MPI_COMM_WORLD);
+    for (int64 i = begin_entry; i < entry; ++i) {
+      delta_buffer_[cells[i] - first_cell] = 0;
+    }
+    ++num_chunks;
+
+    // The owner's post-processing: only the nonzero sums are sent on.
+    // The padding past the last word is always zero.
+    double encode_start = MPI_Wtime();
+    const int64 first_owned_cell = first_cell + block_size * myid;
+    for (int64 i = 0; i < block_size; ++i) {
+      if (owned_buffer_[i] != 0) {
+        // The changes are exchanged as int32 counts.
+        CHECK_LE(owned_buffer_[i], INT_MAX);
+        CHECK_GE(owned_buffer_[i], INT_MIN);
+        owned_delta.mutable_cells()->push_back(first_owned_cell + i);
+        owned_delta.mutable_counts()->push_back(owned_buffer_[i]);
+      }
+    }
+    encode_time_ += MPI_Wtime() - encode_start;
+  }
+  double encode_start = MPI_Wtime();
+  string encoded;
+  row_encodings_.assign(kNumRowEncodings, 0);
+  EncodeModelDelta(owned_delta, &encoded, &row_encodings_);
+  encode_time_ += MPI_Wtime() - encode_start;
+  encoded_bytes_ = encoded.size();
+
+  int local_size = encoded.size();
+  vector<int> sizes(pnum);
+  MPI_Allgather(&local_size, 1, MPI_INT, &sizes[0], 1, MPI_INT,
+                MPI_COMM_WORLD);
+  vector<int> displacements(pnum, 0);
+  for (int i = 1; i < pnum; ++i) {
+    displacements[i] = displacements[i - 1] + sizes[i - 1];
+  }
+  int total_size = displacements[pnum - 1] + sizes[pnum - 1];
+  vector<char> all_encoded(total_size);
+  MPI_Allgatherv(&encoded[0], local_size, MPI_CHAR, &all_encoded[0],
+                 &sizes[0], &displacements[0], MPI_CHAR, MPI_COMM_WORLD);
+
+  double decode_start = MPI_Wtime();
+  LDAModelDelta all_deltas(num_topics);
+  for (int p = 0; p < pnum; ++p) {
+    CHECK(DecodeModelDelta(&all_encoded[displacements[p]], sizes[p],
+                           &all_deltas));
+  }
+  // Our own changes are already in the model.
+  for (int64 i = 0; i < cells.size(); ++i) {
+    all_deltas.mutable_cells()->push_back(cells[i]);
+    all_deltas.mutable_counts()->push_back(-counts[i]);
+  }
+  ApplyDelta(all_deltas);
+  decode_time_ = MPI_Wtime() - decode_start;
+  bytes_communicated_ =
+      num_chunks * block_size * (pnum - 1) * sizeof(int64) +
+      total_size - local_size;
+  delta->clear();
+}
+
+void ParallelLDAModel::NodeDenseAllReduce(LDAModelDelta* delta) {
+  // The changes of the node are gathered at its leader.
+  delta->Compact();
+  int local_size = delta->size();
+  vector<int> sizes(node_size_);
+  MPI_Gather(&local_size, 1, MPI_INT, &sizes[0], 1, MPI_INT, 0, node_comm_);
+  vector<int> displacements(node_size_, 0);
+  for (int i = 1; i < node_size_; ++i) {
+    displacements[i] = displacements[i - 1] + sizes[i - 1];
+  }
+  int total_size = displacements[node_size_ - 1] + sizes[node_size_ - 1];
+  LDAModelDelta node_delta(num_topics());
+  node_delta.mutable_cells()->resize(std::max(total_size, 1));
+  node_delta.mutable_counts()->resize(std::max(total_size, 1));
+  // Gatherv does not accept a NULL buffer even for empty deltas.
+  int64 dummy_cell = 0;
+  int32 dummy_count = 0;
+  MPI_Gatherv(local_size > 0 ? &(*delta->mutable_cells())[0] : &dummy_cell,
+              local_size, MPI_LONG_LONG, &(*node_delta.mutable_cells())[0],
+              &sizes[0], &displacements[0], MPI_LONG_LONG, 0, node_comm_);
+  MPI_Gatherv(local_size > 0 ? &(*delta->mutable_counts())[0] :
+              &dummy_count,
+              local_size, MPI_INT, &(*node_delta.mutable_counts())[0],
+              &sizes[0], &displacements[0], MPI_INT, 0, node_comm_);
+  delta->clear();
+  bytes_communicated_ = 0;
+  // The others wait while the leader changes the shared model.
+  if (node_rank_ == 0) {
+    node_delta.mutable_cells()->resize(total_size);
+    node_delta.mutable_counts()->resize(total_size);
+    ChunkedAllReduce(&node_delta, leader_comm_);
+    bytes_communicated_ = dense_bytes();
+  }
+  NodeBarrier();
+}
+
+}  // namespace learning_lda
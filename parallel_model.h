@@ -0,0 +1,264 @@
+// Copyright 2008 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef _OPENSOURCE_GLDA_PARALLEL_MODEL_H__
+#define _OPENSOURCE_GLDA_PARALLEL_MODEL_H__
+
+#include "mpi.h"
+
+#include <deque>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "common.h"
+#include "document.h"
+#include "model.h"
+#include "sampler.h"
+
+namespace learning_lda {
+
+// A wrapper of MPI_Allreduce. If the vector is over 32M, we allreduce part
+// after part. This will save temporary memory needed.
+void AllReduceTopicDistribution(int64* buf, int64 count,
+                                MPI_Comm comm = MPI_COMM_WORLD);
+
+// WordOccurrenceIndex lists the occurrences of every word in a corpus,
+// so that the corpus can be swept word by word instead of document by
+// document.  An occurrence group is a document and the index of a word
+// among the document's unique words; it covers all occurrences of the
+// word in the document.
+class WordOccurrenceIndex {
+ public:
+  WordOccurrenceIndex(const LDACorpus& corpus, int num_words);
+  ~WordOccurrenceIndex() {}
+
+  // The occurrence groups of word are [begin(word), begin(word + 1)).
+  int64 begin(int word) const { return word_begin_[word]; }
+  LDADocument* document(int64 i) const { return groups_[i].first; }
+  int word_index(int64 i) const { return groups_[i].second; }
+
+ private:
+  vector<int64> word_begin_;
+  vector<std::pair<LDADocument*, int> > groups_;
+};
+
+// ParallelLDAModel is an LDAModel whose counts cover the corpora of all
+// MPI processes.  Each process holds a full copy of the model, which is
+// built once by ComputeAndAllReduce and then kept up to date across
+// iterations by exchanging the changes each process made.
+//
+// If node_shared, the processes of a node instead share one copy in an
+// MPI_Win_allocate_shared window, which they change by atomic additions
+// (see LDAModel::set_concurrent).  The first process of every node is
+// its leader: it gathers the changes of the node and only the leaders
+// allreduce.  Only ComputeAndAllReduce and DenseAllReduce support this.
+// The model must be destroyed before MPI_Finalize.
+class ParallelLDAModel : public LDAModel {
+ public:
+  ParallelLDAModel(int num_topic, int num_words, bool node_shared);
+  ~ParallelLDAModel();
+
+  // Counts the topic assignments of the local corpus and sums up the
+  // counts of all processes.  The model must be zero before.
+  void ComputeAndAllReduce(const LDACorpus& corpus);
+
+  // Brings the model up to date with the changes of all processes.
+  // delta holds the changes this process made to the model since the
+  // last synchronization, which are already in the model.  The words
+  // are split into ranges of at most 32M counts; the changes of each
+  // range are scattered into a dense buffer of that size, which is
+  // allreduced with AllReduceTopicDistribution and added to the model.
+  // Clears delta.
+  void DenseAllReduce(LDAModelDelta* delta);
+
+  // Starts synchronizing like DenseAllReduce without waiting for the
+  // other processes: the changes in delta are taken over, and delta is
+  // cleared.  The words are reduced range by range as in
+  // DenseAllReduce, one range at a time by nonblocking MPI_Iallreduce
+  // through a buffer of at most 32M counts per synchronization in
+  // flight; every call lets the ranges of the synchronizations in
+  // flight advance.  The changes of the other processes reach the model
+  // range by range, at the latest in FinishDenseAllReduce, so until
+  // then sampling works on counts that lack some of them.  Every
+  // process must start and finish the same synchronizations in the same
+  // order.
+  void StartDenseAllReduce(LDAModelDelta* delta);
+
+  // Waits for the rest of the oldest synchronization started by
+  // StartDenseAllReduce and adds the changes of the other processes to
+  // the model.  Returns false if none is in flight.
+  bool FinishDenseAllReduce();
+
+  // Returns the number of synchronizations started and not finished.
+  int num_in_flight() const { return in_flight_.size(); }
+
+  // Brings the model up to date with the changes of all processes.
+  // delta holds the changes this process made to the model since the
+  // last synchronization, which are already in the model; only the
+  // nonzero entries of every process's delta are exchanged, by
+  // MPI_Allgatherv of (cell, count) pairs.  Clears delta.
+  void SparseAllReduce(LDAModelDelta* delta);
+
+  // Brings the model up to date with the changes of all processes like
+  // SparseAllReduce, but every process's changes are compressed by
+  // EncodeModelDelta and the encoded buffers are exchanged by
+  // MPI_Allgatherv; each process decodes and adds the changes of the
+  // others.  Clears delta.
+  void CompressedAllReduce(LDAModelDelta* delta);
+
+  // Brings the model up to date with the changes of all processes.
+  // The words are split into ranges of at most 32M counts as in
+  // DenseAllReduce, and every process owns a contiguous 1 / P of each
+  // range.  The changes of a range are scattered into a dense buffer,
+  // which MPI_Reduce_scatter_block sums up so that every process only
+  // receives the reduced rows it owns.  The owner re-encodes the
+  // nonzero changes of its rows with EncodeModelDelta, and the encoded
+  // rows of all ranges are exchanged by MPI_Allgatherv and added to the
+  // model.  Unlike MPI_Allreduce, no process receives the whole dense
+  // buffer.  Clears delta.
+  void ReduceScatterAllReduce(LDAModelDelta* delta);
+
+  // Returns the number of bytes the changes of this process took when
+  // encoded by the last CompressedAllReduce or, for its owned words,
+  // ReduceScatterAllReduce, the seconds it spent on
+  // encoding and on decoding, and the number of word rows it wrote in
+  // each RowEncoding.
+  int64 encoded_bytes() const { return encoded_bytes_; }
+  double encode_time() const { return encode_time_; }
+  double decode_time() const { return decode_time_; }
+  const vector<int64>& row_encodings() const { return row_encodings_; }
+
+  // Performs one iteration of Gibbs sampling over the corpus in index,
+  // overlapped with synchronizing the model.  The words are split into
+  // ranges of at least num_chunks, which are sampled one after another.
+  // As soon as a range is done, its changes are scattered into the
+  // dense buffer and reduced in place by a nonblocking MPI_Iallreduce,
+  // while sampling continues with the next range; reductions that
+  // complete meanwhile are added to the model right away.  Every
+  // process must use the same num_chunks.  sampler must work on this
+  // model and record its changes into delta, which is cleared.
+  void SampleAndAllReduce(const WordOccurrenceIndex& index,
+                          LDASampler* sampler, LDAModelDelta* delta,
+                          int num_chunks);
+
+  // Returns the fraction of the time of the last SampleAndAllReduce
+  // reductions were in flight that overlapped with sampling, i.e., 1
+  // minus the time spent waiting for the last reductions over the time
+  // from the first reduction starting to the last one completing.
+  double overlap_ratio() const { return overlap_ratio_; }
+
+  // Returns the number of bytes this process received in the last
+  // synchronization.
+  int64 bytes_communicated() const { return bytes_communicated_; }
+
+  // Returns the number of bytes of the dense model buffer.
+  int64 dense_bytes() const { return memory_size_ * sizeof(int64); }
+
+  bool node_shared() const { return node_shared_; }
+
+  // Returns the number of processes sharing the model, 1 unless
+  // node_shared.
+  int node_size() const { return node_size_; }
+
+ private:
+  // A synchronization started by StartDenseAllReduce.
+  struct DenseReduction {
+    explicit DenseReduction(int num_topics)
+        : delta(num_topics), begin_word(0), end_word(0), begin_entry(0),
+          end_entry(0), comm(MPI_COMM_NULL), request(MPI_REQUEST_NULL) {}
+    // The changes of words [begin_word, end_word) of all processes, all
+    // zero once added to the model.
+    vector<int64> buffer;
+    // This process's changes, which are already in the model, sorted by
+    // cell; entries [begin_entry, end_entry) are those of the range.
+    LDAModelDelta delta;
+    int begin_word;
+    int end_word;
+    int64 begin_entry;
+    int64 end_entry;
+    // A communicator of its own, since the ranges of the
+    // synchronizations in flight advance in different orders on
+    // different processes.
+    MPI_Comm comm;
+    MPI_Request request;
+  };
+
+  // Scatters the changes of the range of reduction starting at
+  // begin_word into its buffer and starts reducing them.
+  void StartDenseRange(DenseReduction* reduction, int begin_word);
+
+  // Lets the other processes of the node see the changes this one made
+  // to the shared model, and waits for theirs.
+  void NodeBarrier();
+
+  // DenseAllReduce of a node_shared model.  The leader gathers the
+  // changes of its node, allreduces them with the other leaders and adds
+  // the changes of the other nodes to the model.
+  void NodeDenseAllReduce(LDAModelDelta* delta);
+
+  // Allreduces the changes in delta among comm range by range through
+  // chunk_buffer_, as DenseAllReduce describes, and adds the changes of
+  // the others to the model.  Compacts delta.
+  void ChunkedAllReduce(LDAModelDelta* delta, MPI_Comm comm);
+
+  // Adds the reduced changes of words [begin_word, end_word) in reduced,
+  // which starts at the first count of begin_word, to the model and
+  // clears them there.  Entries [begin_entry, end_entry) of delta are
+  // this process's changes of those words, which are already in the
+  // model.
+  void AddReducedDelta(int64* reduced, int begin_word, int end_word,
+                       const LDAModelDelta& delta,
+                       int64 begin_entry, int64 end_entry);
+
+  bool node_shared_;
+  // The processes of this node, and its leaders of all nodes, which is
+  // MPI_COMM_NULL on other processes.  Only used if node_shared_.
+  MPI_Comm node_comm_;
+  MPI_Comm leader_comm_;
+  int node_rank_;
+  int node_size_;
+  MPI_Win window_;
+
+  int64 bytes_communicated_;
+  double overlap_ratio_;
+  int64 encoded_bytes_;
+  double encode_time_;
+  double decode_time_;
+  vector<int64> row_encodings_;
+
+  // The word topic count changes of all processes, used by
+  // SampleAndAllReduce, and of this process to one range of words,
+  // padded to P equal shares, by ReduceScatterAllReduce.  All zero
+  // between synchronizations.
+  vector<int64> delta_buffer_;
+
+  // The changes of all processes to one range of words in
+  // ChunkedAllReduce.  All zero between synchronizations.
+  vector<int64> chunk_buffer_;
+
+  // The reduced changes of the words this process owns in one range of
+  // ReduceScatterAllReduce.
+  vector<int64> owned_buffer_;
+
+  // The synchronizations started by StartDenseAllReduce and not yet
+  // finished, oldest first, and the finished ones kept for reuse.
+  std::deque<DenseReduction*> in_flight_;
+  vector<DenseReduction*> free_reductions_;
+};
+
+}  // namespace learning_lda
+
+#endif  // _OPENSOURCE_GLDA_PARALLEL_MODEL_H__
@@ -0,0 +1,265 @@
+// Copyright 2008 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "parameter_server.h"
+
+#include <limits.h>
+
+#include <algorithm>
+
+namespace learning_lda {
+
+ParameterServerShard::ParameterServerShard(int shard_id, int num_shards,
+                                           int num_topics, int num_words)
+    : num_shards_(num_shards),
+      num_topics_(num_topics),
+      topic_counts_(num_topics, 0) {
+  CHECK_LE(0, shard_id);
+  CHECK_LT(shard_id, num_shards);
+  int num_rows = num_words / num_shards +
+      (shard_id < num_words % num_shards ? 1 : 0);
+  rows_.resize(static_cast<int64>(num_rows) * num_topics, 0);
+}
+
+void ParameterServerShard::GetRow(int word, int64* row) const {
+  const int64* source =
+      &rows_[static_cast<int64>(word / num_shards_) * num_topics_];
+  std::copy(source, source + num_topics_, row);
+}
+
+void ParameterServerShard::Add(int word, int topic, int64 count) {
+  rows_[static_cast<int64>(word / num_shards_) * num_topics_ + topic] +=
+      count;
+  topic_counts_[topic] += count;
+}
+
+BoundedStalenessClock::BoundedStalenessClock(int num_workers, int staleness)
+    : clocks_(num_workers, 0), staleness_(staleness) {
+  CHECK_LE(0, staleness);
+}
+
+int64 BoundedStalenessClock::Tick(int worker) {
+  return ++clocks_[worker];
+}
+
+void BoundedStalenessClock::Finish(int worker) {
+  clocks_[worker] = LLONG_MAX;
+}
+
+bool BoundedStalenessClock::CanProceed(int64 clock) const {
+  return *std::min_element(clocks_.begin(), clocks_.end()) >=
+      clock - staleness_;
+}
+
+LocalParameterServer::LocalParameterServer(int num_shards, int num_topics,
+                                           int num_words, int num_workers,
+                                           int staleness)
+    : num_topics_(num_topics),
+      num_words_(num_words),
+      shard_mutexes_(num_shards),
+      clock_(num_workers, staleness) {
+  for (int i = 0; i < num_shards; ++i) {
+    shards_.push_back(
+        new ParameterServerShard(i, num_shards, num_topics, num_words));
+    pthread_mutex_init(&shard_mutexes_[i], NULL);
+  }
+  pthread_mutex_init(&clock_mutex_, NULL);
+  pthread_cond_init(&clock_cond_, NULL);
+}
+
+LocalParameterServer::~LocalParameterServer() {
+  for (int i = 0; i < shards_.size(); ++i) {
+    delete shards_[i];
+    pthread_mutex_destroy(&shard_mutexes_[i]);
+  }
+  pthread_mutex_destroy(&clock_mutex_);
+  pthread_cond_destroy(&clock_cond_);
+}
+
+void LocalParameterServer::Pull(const vector<int>& words, int64* rows,
+                                int64* global) {
+  const int num_shards = shards_.size();
+  std::fill(global, global + num_topics_, 0);
+  for (int s = 0; s < num_shards; ++s) {
+    pthread_mutex_lock(&shard_mutexes_[s]);
+    for (int i = 0; i < words.size(); ++i) {
+      if (words[i] % num_shards == s) {
+        shards_[s]->GetRow(words[i], rows + static_cast<int64>(i) * num_topics_);
+      }
+    }
+    const vector<int64>& topic_counts = shards_[s]->topic_counts();
+    for (int k = 0; k < num_topics_; ++k) {
+      global[k] += topic_counts[k];
+    }
+    pthread_mutex_unlock(&shard_mutexes_[s]);
+  }
+}
+
+void LocalParameterServer::Push(const LDAModelDelta& delta) {
+  const int num_shards = shards_.size();
+  const vector<int64>& cells = delta.cells();
+  const vector<int32>& counts = delta.counts();
+  // Group the changes by shard, so that every shard is locked once.
+  vector<vector<int> > entries(num_shards);
+  for (int64 i = 0; i < cells.size(); ++i) {
+    entries[(cells[i] / num_topics_) % num_shards].push_back(i);
+  }
+  for (int s = 0; s < num_shards; ++s) {
+    if (entries[s].empty()) {
+      continue;
+    }
+    pthread_mutex_lock(&shard_mutexes_[s]);
+    for (int j = 0; j < entries[s].size(); ++j) {
+      int i = entries[s][j];
+      shards_[s]->Add(cells[i] / num_topics_, cells[i] % num_topics_,
+                      counts[i]);
+    }
+    pthread_mutex_unlock(&shard_mutexes_[s]);
+  }
+}
+
+void LocalParameterServer::Clock(int worker) {
+  pthread_mutex_lock(&clock_mutex_);
+  int64 clock = clock_.Tick(worker);
+  pthread_cond_broadcast(&clock_cond_);
+  while (!clock_.CanProceed(clock)) {
+    pthread_cond_wait(&clock_cond_, &clock_mutex_);
+  }
+  pthread_mutex_unlock(&clock_mutex_);
+}
+
+void LocalParameterServer::Finish(int worker) {
+  pthread_mutex_lock(&clock_mutex_);
+  clock_.Finish(worker);
+  pthread_cond_broadcast(&clock_cond_);
+  pthread_mutex_unlock(&clock_mutex_);
+}
+
+void LocalParameterServer::AppendAsString(
+    const map<string, int>& word_index_map, std::ostream& out) {
+  vector<string> index_word_map(word_index_map.size());
+  for (map<string, int>::const_iterator iter = word_index_map.begin();
+       iter != word_index_map.end(); ++iter) {
+    index_word_map[iter->second] = iter->first;
+  }
+  vector<int> word(1);
+  vector<int64> row(num_topics_);
+  vector<int64> global(num_topics_);
+  for (int w = 0; w < num_words_; ++w) {
+    word[0] = w;
+    Pull(word, &row[0], &global[0]);
+    out << index_word_map[w] << "\t";
+    for (int k = 0; k < num_topics_; ++k) {
+      out << row[k] << ((k < num_topics_ - 1) ? " " : "\n");
+    }
+  }
+}
+
+ParameterServerWorker::ParameterServerWorker(
+    int worker, int num_topics, double alpha, double beta,
+    const map<string, int>& word_index_map, int num_words,
+    LDACorpus* corpus, ParameterServer* server)
+    : worker_(worker),
+      num_topics_(num_topics),
+      corpus_(corpus),
+      server_(server),
+      delta_(num_topics),
+      bytes_pulled_(0),
+      bytes_pushed_(0) {
+  map<string, int> local_word_index_map;
+  for (list<LDADocument*>::iterator iter = corpus->begin();
+       iter != corpus->end();
+       ++iter) {
+    const DocumentWordTopicsPB& topics = (*iter)->topics();
+    for (int i = 0; i < topics.words_s_.size(); ++i) {
+      local_word_index_map.insert(
+          std::make_pair(topics.words_s_[i], local_word_index_map.size()));
+    }
+  }
+  local_words_.resize(local_word_index_map.size());
+  for (map<string, int>::const_iterator iter = local_word_index_map.begin();
+       iter != local_word_index_map.end(); ++iter) {
+    map<string, int>::const_iterator global_iter =
+        word_index_map.find(iter->first);
+    CHECK(global_iter != word_index_map.end());
+    local_words_[iter->second] = global_iter->second;
+  }
+  for (list<LDADocument*>::iterator iter = corpus->begin();
+       iter != corpus->end();
+       ++iter) {
+    (*iter)->ResetWordIndex(local_word_index_map);
+  }
+  model_ = new LDAModelCache(num_topics, local_word_index_map);
+  sampler_ = new LDASampler(alpha, beta, model_, NULL);
+  sampler_->set_vocabulary_size(num_words);
+  sampler_->set_model_delta(&delta_);
+}
+
+ParameterServerWorker::~ParameterServerWorker() {
+  delete sampler_;
+  delete model_;
+}
+
+void ParameterServerWorker::Initialize() {
+  for (list<LDADocument*>::iterator iter = corpus_->begin();
+       iter != corpus_->end();
+       ++iter) {
+    for (LDADocument::WordOccurrenceIterator iter2(*iter);
+         !iter2.Done(); iter2.Next()) {
+      delta_.Add(iter2.Word(), iter2.Topic(), 1);
+    }
+  }
+  PushDelta();
+  server_->Clock(worker_);
+}
+
+void ParameterServerWorker::DoIteration() {
+  Pull();
+  sampler_->DoIteration(corpus_, true, false);
+  PushDelta();
+  server_->Clock(worker_);
+}
+
+void ParameterServerWorker::Pull() {
+  int64* memory = model_->mutable_memory();
+  server_->Pull(local_words_, memory,
+                memory + static_cast<int64>(local_words_.size()) *
+                num_topics_);
+  bytes_pulled_ += (local_words_.size() + 1) * num_topics_ * sizeof(int64);
+}
+
+double ParameterServerWorker::LogLikelihood() const {
+  double loglikelihood = 0;
+  for (list<LDADocument*>::const_iterator iter = corpus_->begin();
+       iter != corpus_->end();
+       ++iter) {
+    loglikelihood += sampler_->LogLikelihood(*iter);
+  }
+  return loglikelihood;
+}
+
+void ParameterServerWorker::PushDelta() {
+  delta_.Compact();
+  vector<int64>* cells = delta_.mutable_cells();
+  for (int64 i = 0; i < cells->size(); ++i) {
+    int64 word = (*cells)[i] / num_topics_;
+    (*cells)[i] = static_cast<int64>(local_words_[word]) * num_topics_ +
+        (*cells)[i] % num_topics_;
+  }
+  server_->Push(delta_);
+  bytes_pushed_ += delta_.size() * (sizeof(int64) + sizeof(int32));
+  delta_.clear();
+}
+
+}  // namespace learning_lda
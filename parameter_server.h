@@ -0,0 +1,204 @@
+// Copyright 2008 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef _OPENSOURCE_GLDA_PARAMETER_SERVER_H__
+#define _OPENSOURCE_GLDA_PARAMETER_SERVER_H__
+
+#include <pthread.h>
+
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "common.h"
+#include "document.h"
+#include "model.h"
+#include "sampler.h"
+
+namespace learning_lda {
+
+// ParameterServer is the interface through which training workers reach
+// the word-topic counts of a model held by a parameter server.  Words
+// are identified by their global index.  Implementations decide where
+// the counts live; LocalParameterServer keeps them in the process and
+// MPIParameterServer on dedicated MPI processes.
+class ParameterServer {
+ public:
+  virtual ~ParameterServer() {}
+
+  // Copies the counts of words into rows, num_topics counts per word in
+  // the order of words, and the global topic counts into global.
+  virtual void Pull(const vector<int>& words, int64* rows, int64* global) = 0;
+
+  // Adds the changes in delta, whose cells are over global word indices.
+  virtual void Push(const LDAModelDelta& delta) = 0;
+
+  // Advances the clock of worker by one, then blocks until no worker's
+  // clock is more than the staleness bound behind it.  Changes pushed by
+  // a worker before it clocks are visible to pulls that follow the clock
+  // calls waiting for it.
+  virtual void Clock(int worker) = 0;
+};
+
+// ParameterServerShard stores the rows of the words whose index modulo
+// num_shards is shard_id, together with the topic counts of those words.
+// The global topic counts are the sum of the topic counts of all shards.
+// This class is not thread-safe.
+class ParameterServerShard {
+ public:
+  ParameterServerShard(int shard_id, int num_shards, int num_topics,
+                       int num_words);
+  ~ParameterServerShard() {}
+
+  // Copies the counts of word, which must belong to this shard, into row.
+  void GetRow(int word, int64* row) const;
+
+  // Adds count to the count of word, which must belong to this shard,
+  // and topic.
+  void Add(int word, int topic, int64 count);
+
+  // Returns the topic counts of the words of this shard.
+  const vector<int64>& topic_counts() const { return topic_counts_; }
+
+  // Returns the number of bytes taken by the shard.
+  int64 memory_size() const {
+    return (rows_.size() + topic_counts_.size()) * sizeof(int64);
+  }
+
+ private:
+  const int num_shards_;
+  const int num_topics_;
+  vector<int64> rows_;
+  vector<int64> topic_counts_;
+};
+
+// BoundedStalenessClock implements the stale synchronous parallel
+// condition: a worker that has finished clock c iterations may go on
+// only while the slowest worker has finished at least c - staleness.
+// This class is not thread-safe.
+class BoundedStalenessClock {
+ public:
+  BoundedStalenessClock(int num_workers, int staleness);
+  ~BoundedStalenessClock() {}
+
+  // Advances the clock of worker and returns it.
+  int64 Tick(int worker);
+
+  // Marks worker as finished, so that it no longer holds others back.
+  void Finish(int worker);
+
+  // Returns true if a worker whose clock is clock may go on.
+  bool CanProceed(int64 clock) const;
+
+ private:
+  vector<int64> clocks_;
+  const int staleness_;
+};
+
+// LocalParameterServer keeps the shards in this process, for workers
+// running as threads of it.  Pulls and pushes lock every shard they
+// touch once.  This class is thread-safe.
+class LocalParameterServer : public ParameterServer {
+ public:
+  LocalParameterServer(int num_shards, int num_topics, int num_words,
+                       int num_workers, int staleness);
+  virtual ~LocalParameterServer();
+
+  virtual void Pull(const vector<int>& words, int64* rows, int64* global);
+  virtual void Push(const LDAModelDelta& delta);
+  virtual void Clock(int worker);
+
+  // Marks worker as finished.
+  void Finish(int worker);
+
+  // Output the model in the format of LDAModel::AppendAsString.
+  void AppendAsString(const map<string, int>& word_index_map,
+                      std::ostream& out);
+
+ private:
+  const int num_topics_;
+  const int num_words_;
+  vector<ParameterServerShard*> shards_;
+  vector<pthread_mutex_t> shard_mutexes_;
+  BoundedStalenessClock clock_;
+  pthread_mutex_t clock_mutex_;
+  pthread_cond_t clock_cond_;
+};
+
+// LDAModelCache is an LDAModel holding the rows of the words of a
+// worker's documents, filled by pulls from a parameter server.
+class LDAModelCache : public LDAModel {
+ public:
+  LDAModelCache(int num_topic, const map<string, int>& word_index_map)
+      : LDAModel(num_topic, word_index_map) {
+  }
+
+  // The rows of the words, followed by the global topic counts.
+  int64* mutable_memory() { return memory_; }
+};
+
+// ParameterServerWorker trains an LDA model held by a parameter server
+// on its documents.  Each iteration it pulls the rows of only the words
+// of its documents, performs Gibbs sampling on them and pushes the
+// changes it made, then clocks.
+class ParameterServerWorker {
+ public:
+  // The words of corpus are re-indexed to the worker's own vocabulary;
+  // word_index_map gives their global indices among the num_words words
+  // of the model.
+  ParameterServerWorker(int worker, int num_topics, double alpha,
+                        double beta, const map<string, int>& word_index_map,
+                        int num_words, LDACorpus* corpus,
+                        ParameterServer* server);
+  ~ParameterServerWorker();
+
+  // Pushes the counts of the initial topic assignments and clocks.
+  void Initialize();
+
+  // Performs one iteration of Gibbs sampling on the pulled rows, pushes
+  // the changes and clocks.
+  void DoIteration();
+
+  // Pulls the rows of the worker's words.
+  void Pull();
+
+  // Returns the log likelihood of the worker's documents on the rows
+  // pulled last.
+  double LogLikelihood() const;
+
+  // Returns the number of bytes pulled and pushed so far.
+  int64 bytes_pulled() const { return bytes_pulled_; }
+  int64 bytes_pushed() const { return bytes_pushed_; }
+
+ private:
+  // Pushes delta_ translated to global word indices and clears it.
+  void PushDelta();
+
+  const int worker_;
+  const int num_topics_;
+  LDACorpus* corpus_;
+  ParameterServer* server_;
+  // local_words_[i] is the global index of the worker's word i.
+  vector<int> local_words_;
+  LDAModelCache* model_;
+  LDASampler* sampler_;
+  LDAModelDelta delta_;
+  int64 bytes_pulled_;
+  int64 bytes_pushed_;
+};
+
+}  // namespace learning_lda
+
+#endif  // _OPENSOURCE_GLDA_PARAMETER_SERVER_H__
@@ -0,0 +1,89 @@
+// Copyright 2008 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+/*
+  Splits a training corpus into per-process shards of about the same
+  number of word occurrences.  An example running of this program:
+
+  ./partition_corpus \
+  --training_data_file ./testdata/test_data.txt \
+  --num_partitions 8 \
+  --partition_file_prefix /tmp/test_data
+
+  Documents are assigned by the greedy longest-processing-time rule and
+  shard i is written to <partition_file_prefix>-<i>-of-<num_partitions>.
+  The shards are read by mpi_lda --partition_mode shards with
+  --training_data_file <partition_file_prefix>, run with num_partitions
+  processes (or workers).  The token count of every shard is printed.
+*/
+
+#include <fstream>
+#include <string>
+
+#include "common.h"
+#include "corpus_partition.h"
+#include "cmd_flags.h"
+
+int main(int argc, char** argv) {
+  using learning_lda::LDACmdLineFlags;
+  using learning_lda::CountDocumentTokens;
+  using learning_lda::LongestProcessingTimePartition;
+  using learning_lda::PartitionFileName;
+
+  LDACmdLineFlags flags;
+  flags.ParseCmdFlags(argc, argv);
+  if (!flags.CheckPartitioningValidity()) {
+    return -1;
+  }
+  vector<string> documents;
+  vector<int64> tokens;
+  std::ifstream fin(flags.training_data_file_.c_str());
+  string line;
+  while (getline(fin, line)) {  // Each line is a training document.
+    if (line.size() > 0 &&      // Skip empty lines.
+        line[0] != '\r' &&      // Skip empty lines.
+        line[0] != '\n' &&      // Skip empty lines.
+        line[0] != '#') {       // Skip comment lines.
+      documents.push_back(line);
+      tokens.push_back(CountDocumentTokens(line));
+    }
+  }
+  CHECK_GT(documents.size(), 0);
+
+  vector<int> partitions;
+  LongestProcessingTimePartition(tokens, flags.num_partitions_, &partitions);
+  vector<std::ofstream*> shards(flags.num_partitions_);
+  vector<int64> shard_tokens(flags.num_partitions_, 0);
+  for (int i = 0; i < shards.size(); ++i) {
+    shards[i] = new std::ofstream(
+        PartitionFileName(flags.partition_file_prefix_, i,
+                          flags.num_partitions_).c_str());
+  }
+  // Documents keep their relative order within a shard.
+  for (int i = 0; i < documents.size(); ++i) {
+    *shards[partitions[i]] << documents[i] << "\n";
+    shard_tokens[partitions[i]] += tokens[i];
+  }
+  int64 max_tokens = 0;
+  int64 total_tokens = 0;
+  for (int i = 0; i < shards.size(); ++i) {
+    delete shards[i];
+    std::cout << "Shard " << i << ": " << shard_tokens[i] << " tokens\n";
+    max_tokens = std::max(max_tokens, shard_tokens[i]);
+    total_tokens += shard_tokens[i];
+  }
+  std::cout << "Max/mean tokens per shard: "
+            << static_cast<double>(max_tokens) * shards.size() / total_tokens
+            << std::endl;
+  return 0;
+}
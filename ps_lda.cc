@@ -0,0 +1,189 @@
+// Copyright 2008 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+/*
+  Trains a model held by an in-process parameter server with worker
+  threads.  An example running of this program:
+
+  ./ps_lda           \
+  --num_topics 2 \
+  --alpha 0.1    \
+  --beta 0.01                                           \
+  --training_data_file ./testdata/test_data.txt \
+  --model_file /tmp/lda_model.txt                       \
+  --total_iterations 150                                \
+  --num_threads 4                                       \
+  --num_servers 2                                       \
+  --staleness 1
+
+  The documents are dealt to num_threads workers, which pull the rows of
+  their words from num_servers shards, push the changes they make and
+  may run up to staleness iterations ahead of the slowest worker.
+*/
+
+#include <pthread.h>
+
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <map>
+
+#include "common.h"
+#include "document.h"
+#include "parameter_server.h"
+#include "cmd_flags.h"
+
+namespace learning_lda {
+
+using std::ifstream;
+using std::istringstream;
+using std::map;
+
+// Loads the corpus and deals its documents to num_workers corpora.
+int LoadAndInitTrainingCorpora(const string& corpus_file,
+                               int num_topics,
+                               vector<LDACorpus>* corpora,
+                               map<string, int>* word_index_map) {
+  word_index_map->clear();
+  ifstream fin(corpus_file.c_str());
+  string line;
+  int num_documents = 0;
+  while (getline(fin, line)) {  // Each line is a training document.
+    if (line.size() > 0 &&      // Skip empty lines.
+        line[0] != '\r' &&      // Skip empty lines.
+        line[0] != '\n' &&      // Skip empty lines.
+        line[0] != '#') {       // Skip comment lines.
+      istringstream ss(line);
+      DocumentWordTopicsPB document;
+      string word;
+      int count;
+      while (ss >> word >> count) {  // Load and init a document.
+        vector<int32> topics;
+        for (int i = 0; i < count; ++i) {
+          topics.push_back(RandInt(num_topics));
+        }
+        int word_index;
+        map<string, int>::const_iterator iter = word_index_map->find(word);
+        if (iter == word_index_map->end()) {
+          word_index = word_index_map->size();
+          (*word_index_map)[word] = word_index;
+        } else {
+          word_index = iter->second;
+        }
+        document.add_wordtopics(word, word_index, topics);
+      }
+      (*corpora)[num_documents % corpora->size()].push_back(
+          new LDADocument(document, num_topics));
+      ++num_documents;
+    }
+  }
+  return num_documents;
+}
+
+void FreeCorpus(LDACorpus* corpus) {
+  for (list<LDADocument*>::iterator iter = corpus->begin();
+       iter != corpus->end();
+       ++iter) {
+    if (*iter != NULL) {
+      delete *iter;
+      *iter = NULL;
+    }
+  }
+}
+
+struct WorkerContext {
+  ParameterServerWorker* worker;
+  LocalParameterServer* server;
+  int worker_id;
+  int num_iterations;
+};
+
+void* WorkerThread(void* arg) {
+  WorkerContext* context = static_cast<WorkerContext*>(arg);
+  context->worker->Initialize();
+  for (int iter = 0; iter < context->num_iterations; ++iter) {
+    context->worker->DoIteration();
+  }
+  context->server->Finish(context->worker_id);
+  return NULL;
+}
+
+}  // namespace learning_lda
+
+int main(int argc, char** argv) {
+  using learning_lda::LDACorpus;
+  using learning_lda::LocalParameterServer;
+  using learning_lda::ParameterServerWorker;
+  using learning_lda::WorkerContext;
+  using learning_lda::LoadAndInitTrainingCorpora;
+  using learning_lda::LDACmdLineFlags;
+  using learning_lda::WallTime;
+
+  LDACmdLineFlags flags;
+  flags.ParseCmdFlags(argc, argv);
+  if (!flags.CheckParameterServerValidity()) {
+    return -1;
+  }
+  srand(time(NULL));
+  vector<LDACorpus> corpora(flags.num_threads_);
+  map<string, int> word_index_map;
+  CHECK_GT(LoadAndInitTrainingCorpora(flags.training_data_file_,
+                                      flags.num_topics_,
+                                      &corpora, &word_index_map), 0);
+  LocalParameterServer server(flags.num_servers_, flags.num_topics_,
+                              word_index_map.size(), flags.num_threads_,
+                              flags.staleness_);
+  vector<ParameterServerWorker*> workers(flags.num_threads_);
+  vector<WorkerContext> contexts(flags.num_threads_);
+  vector<pthread_t> threads(flags.num_threads_);
+  for (int i = 0; i < flags.num_threads_; ++i) {
+    workers[i] = new ParameterServerWorker(i, flags.num_topics_, flags.alpha_,
+                                           flags.beta_, word_index_map,
+                                           word_index_map.size(),
+                                           &corpora[i], &server);
+    contexts[i].worker = workers[i];
+    contexts[i].server = &server;
+    contexts[i].worker_id = i;
+    contexts[i].num_iterations = flags.total_iterations_;
+  }
+  double start = WallTime();
+  for (int i = 0; i < flags.num_threads_; ++i) {
+    pthread_create(&threads[i], NULL, learning_lda::WorkerThread,
+                   &contexts[i]);
+  }
+  for (int i = 0; i < flags.num_threads_; ++i) {
+    pthread_join(threads[i], NULL);
+  }
+  std::cout << "Trained " << flags.total_iterations_ << " iterations in "
+            << WallTime() - start << " seconds" << std::endl;
+
+  double loglikelihood = 0;
+  for (int i = 0; i < flags.num_threads_; ++i) {
+    workers[i]->Pull();
+    if (flags.compute_likelihood_ == "true") {
+      loglikelihood += workers[i]->LogLikelihood();
+    }
+    std::cout << "Worker " << i << " pulled "
+              << workers[i]->bytes_pulled() << " bytes, pushed "
+              << workers[i]->bytes_pushed() << " bytes" << std::endl;
+    delete workers[i];
+    learning_lda::FreeCorpus(&corpora[i]);
+  }
+  if (flags.compute_likelihood_ == "true") {
+    std::cout << "Loglikelihood: " << loglikelihood << std::endl;
+  }
+
+  std::ofstream fout(flags.model_file_.c_str());
+  server.AppendAsString(word_index_map, fout);
+  return 0;
+}
@@ -0,0 +1,115 @@
+// Copyright 2008 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+/*
+  Converts a trained model into the compact quantized format read by
+  infer and infer_server.  An example running of this program:
+
+  ./quantize_model \
+  --beta 0.01                                           \
+  --model_file /tmp/lda_model.txt                       \
+  --quantized_model_file /tmp/lda_model.q8              \
+  --quantization_bits 8
+
+  beta should be the same with training.  The memory taken by the model
+  before and after quantization and the quantization error are printed.
+*/
+
+#include <math.h>
+
+#include <algorithm>
+#include <fstream>
+#include <string>
+
+#include "common.h"
+#include "model.h"
+#include "quantized_model.h"
+#include "vocabulary.h"
+#include "cmd_flags.h"
+
+int main(int argc, char** argv) {
+  using learning_lda::LDAModel;
+  using learning_lda::LDAQuantizedModel;
+  using learning_lda::LDACmdLineFlags;
+  using learning_lda::VocabularyFilter;
+  using std::ifstream;
+  using std::ofstream;
+
+  LDACmdLineFlags flags;
+  flags.ParseCmdFlags(argc, argv);
+  if (!flags.CheckQuantizingValidity()) {
+    return -1;
+  }
+  map<string, int> word_index_map;
+  ifstream model_fin(flags.model_file_.c_str());
+  // The vocabulary filter of the model is kept in front of the quantized
+  // model for infer.
+  VocabularyFilter vocabulary_filter;
+  vocabulary_filter.ReadHeader(model_fin);
+  LDAModel model(model_fin, &word_index_map);
+  LDAQuantizedModel quantized_model(model, flags.beta_,
+                                    flags.quantization_bits_);
+  ofstream fout(flags.quantized_model_file_.c_str(), std::ios::binary);
+  vocabulary_filter.AppendAsString(fout);
+  quantized_model.Save(word_index_map, fout);
+
+  // Measure the quantization error of P(w|z) and of P(z|w), which is
+  // what inference depends on.
+  const int num_topics = model.num_topics();
+  const int num_words = model.num_words();
+  const TopicCountDistribution& global_distribution =
+      model.GetGlobalTopicDistribution();
+  double sum_relative_error = 0;
+  double max_relative_error = 0;
+  double sum_kl_divergence = 0;
+  double max_kl_divergence = 0;
+  vector<double> probs(num_topics);
+  vector<double> quantized_probs(num_topics);
+  for (LDAModel::Iterator iter(&model); !iter.Done(); iter.Next()) {
+    double sum = 0;
+    double quantized_sum = 0;
+    for (int k = 0; k < num_topics; ++k) {
+      probs[k] = (iter.Distribution()[k] + flags.beta_) /
+          (global_distribution[k] + num_words * flags.beta_);
+      quantized_probs[k] =
+          quantized_model.GetWordTopicProbability(iter.Word(), k);
+      double relative_error = fabs(quantized_probs[k] / probs[k] - 1);
+      sum_relative_error += relative_error;
+      max_relative_error = std::max(max_relative_error, relative_error);
+      sum += probs[k];
+      quantized_sum += quantized_probs[k];
+    }
+    double kl_divergence = 0;
+    for (int k = 0; k < num_topics; ++k) {
+      kl_divergence += probs[k] / sum *
+          log((probs[k] / sum) / (quantized_probs[k] / quantized_sum));
+    }
+    sum_kl_divergence += kl_divergence;
+    max_kl_divergence = std::max(max_kl_divergence, kl_divergence);
+  }
+
+  std::cout << "Quantized " << num_words << " words x " << num_topics
+            << " topics to " << flags.quantization_bits_ << " bits\n";
+  std::cout << "Model memory: "
+            << static_cast<int64>(num_words) * num_topics * sizeof(int64)
+            << " bytes of counts, " << quantized_model.memory_size()
+            << " bytes quantized\n";
+  std::cout << "P(w|z) relative error: mean "
+            << sum_relative_error / (static_cast<double>(num_words) *
+                                     num_topics)
+            << " max " << max_relative_error << "\n";
+  std::cout << "KL(P(z|w) || quantized P(z|w)): mean "
+            << sum_kl_divergence / num_words
+            << " max " << max_kl_divergence << "\n";
+  return 0;
+}
@@ -0,0 +1,234 @@
+// Copyright 2008 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "quantized_model.h"
+
+#include <math.h>
+
+#include <algorithm>
+
+namespace learning_lda {
+
+namespace {
+
+const char kQuantizedModelMagic[] = "PLDAQNT1";
+const int kQuantizedModelMagicSize = 8;
+
+// The range of log probability ratios within a word that can be
+// represented.  Topics less likely than exp(-kMaxLogRatio) times the most
+// likely topic of a word hardly matter to inference.
+const double kMaxLogRatio = 20;
+
+template <typename T>
+void WriteValue(std::ostream& out, const T& value) {
+  out.write(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+template <typename T>
+void ReadValue(std::istream& in, T* value) {
+  in.read(reinterpret_cast<char*>(value), sizeof(*value));
+}
+
+template <typename T>
+void WriteVector(std::ostream& out, const vector<T>& values) {
+  if (!values.empty()) {
+    out.write(reinterpret_cast<const char*>(&values[0]),
+              sizeof(values[0]) * values.size());
+  }
+}
+
+template <typename T>
+void ReadVector(std::istream& in, int64 size, vector<T>* values) {
+  values->resize(size);
+  if (size > 0) {
+    in.read(reinterpret_cast<char*>(&(*values)[0]),
+            sizeof((*values)[0]) * size);
+  }
+}
+
+}  // namespace
+
+LDAQuantizedModel::LDAQuantizedModel(const LDAModel& model,
+                                     double beta, int bits)
+    : num_topics_(model.num_topics()),
+      num_words_(model.num_words()),
+      bits_(bits) {
+  CHECK_LT(0.0, beta);
+  CHECK(bits == 8 || bits == 16);
+  const int max_code = (1 << bits) - 1;
+  step_ = kMaxLogRatio / max_code;
+  ComputeLevels();
+
+  int64 size = static_cast<int64>(num_topics_) * num_words_;
+  if (bits == 8) {
+    codes8_.resize(size);
+  } else {
+    codes16_.resize(size);
+  }
+  row_log_max_.resize(num_words_);
+
+  const TopicCountDistribution& global_distribution =
+      model.GetGlobalTopicDistribution();
+  vector<double> log_denominator(num_topics_);
+  for (int k = 0; k < num_topics_; ++k) {
+    log_denominator[k] = log(global_distribution[k] + num_words_ * beta);
+  }
+  vector<double> log_probs(num_topics_);
+  for (LDAModel::Iterator iter(&model); !iter.Done(); iter.Next()) {
+    const TopicCountDistribution& word_distribution = iter.Distribution();
+    double log_max = -1e300;
+    for (int k = 0; k < num_topics_; ++k) {
+      log_probs[k] = log(word_distribution[k] + beta) - log_denominator[k];
+      log_max = std::max(log_max, log_probs[k]);
+    }
+    row_log_max_[iter.Word()] = log_max;
+    int64 offset = static_cast<int64>(iter.Word()) * num_topics_;
+    for (int k = 0; k < num_topics_; ++k) {
+      int code = static_cast<int>((log_max - log_probs[k]) / step_ + 0.5);
+      code = std::min(code, max_code);
+      if (bits == 8) {
+        codes8_[offset + k] = code;
+      } else {
+        codes16_[offset + k] = code;
+      }
+    }
+  }
+}
+
+LDAQuantizedModel::LDAQuantizedModel(std::istream& in,
+                                     map<string, int>* word_index_map) {
+  char magic[kQuantizedModelMagicSize];
+  in.read(magic, kQuantizedModelMagicSize);
+  CHECK(memcmp(magic, kQuantizedModelMagic, kQuantizedModelMagicSize) == 0);
+  int32 num_topics, num_words, bits;
+  ReadValue(in, &num_topics);
+  ReadValue(in, &num_words);
+  ReadValue(in, &bits);
+  ReadValue(in, &step_);
+  num_topics_ = num_topics;
+  num_words_ = num_words;
+  bits_ = bits;
+  CHECK(bits_ == 8 || bits_ == 16);
+  ComputeLevels();
+  word_index_map->clear();
+  for (int i = 0; i < num_words_; ++i) {
+    int32 length;
+    ReadValue(in, &length);
+    string word(length, ' ');
+    in.read(&word[0], length);
+    (*word_index_map)[word] = i;
+  }
+  ReadVector(in, num_words_, &row_log_max_);
+  int64 size = static_cast<int64>(num_topics_) * num_words_;
+  if (bits_ == 8) {
+    ReadVector(in, size, &codes8_);
+  } else {
+    ReadVector(in, size, &codes16_);
+  }
+  CHECK(static_cast<bool>(in));
+}
+
+bool LDAQuantizedModel::IsQuantizedModel(std::istream& in) {
+  std::streampos position = in.tellg();
+  char magic[kQuantizedModelMagicSize];
+  in.read(magic, kQuantizedModelMagicSize);
+  bool quantized = in.gcount() == kQuantizedModelMagicSize &&
+      memcmp(magic, kQuantizedModelMagic, kQuantizedModelMagicSize) == 0;
+  in.clear();
+  in.seekg(position);
+  return quantized;
+}
+
+void LDAQuantizedModel::Save(const map<string, int>& word_index_map,
+                             std::ostream& out) const {
+  CHECK_EQ(num_words_, word_index_map.size());
+  out.write(kQuantizedModelMagic, kQuantizedModelMagicSize);
+  WriteValue(out, static_cast<int32>(num_topics_));
+  WriteValue(out, static_cast<int32>(num_words_));
+  WriteValue(out, static_cast<int32>(bits_));
+  WriteValue(out, step_);
+  vector<string> index_word_map(word_index_map.size());
+  for (map<string, int>::const_iterator iter = word_index_map.begin();
+       iter != word_index_map.end(); ++iter) {
+    index_word_map[iter->second] = iter->first;
+  }
+  for (int i = 0; i < index_word_map.size(); ++i) {
+    WriteValue(out, static_cast<int32>(index_word_map[i].size()));
+    out.write(index_word_map[i].data(), index_word_map[i].size());
+  }
+  WriteVector(out, row_log_max_);
+  if (bits_ == 8) {
+    WriteVector(out, codes8_);
+  } else {
+    WriteVector(out, codes16_);
+  }
+}
+
+void LDAQuantizedModel::ComputeLevels() {
+  levels_.resize(1 << bits_);
+  for (int q = 0; q < levels_.size(); ++q) {
+    levels_[q] = exp(-q * step_);
+  }
+}
+
+void LDAQuantizedModel::GetRelativeWordTopicProbabilities(
+    int word, float* probs) const {
+  int64 offset = static_cast<int64>(word) * num_topics_;
+  if (bits_ == 8) {
+    for (int k = 0; k < num_topics_; ++k) {
+      probs[k] = levels_[codes8_[offset + k]];
+    }
+  } else {
+    for (int k = 0; k < num_topics_; ++k) {
+      probs[k] = levels_[codes16_[offset + k]];
+    }
+  }
+}
+
+double LDAQuantizedModel::GetWordTopicProbability(int word, int topic) const {
+  return exp(row_log_max_[word] - code(word, topic) * step_);
+}
+
+int64 LDAQuantizedModel::memory_size() const {
+  return static_cast<int64>(num_topics_) * num_words_ * (bits_ / 8) +
+      static_cast<int64>(num_words_) * sizeof(row_log_max_[0]);
+}
+
+LDAQuantizedSampler::LDAQuantizedSampler(double alpha,
+                                         const LDAQuantizedModel* model)
+    : alpha_(alpha), model_(model) {
+  CHECK_LT(0.0, alpha);
+  CHECK(model != NULL);
+}
+
+void LDAQuantizedSampler::SampleNewTopicsForDocument(
+    LDADocument* document) const {
+  const int num_topics = model_->num_topics();
+  const vector<int64>& document_distribution = document->topic_distribution();
+  vector<float> word_topic_probs(num_topics);
+  vector<double> new_topic_distribution(num_topics);
+  for (LDADocument::WordOccurrenceIterator iterator(document);
+       !iterator.Done();
+       iterator.Next()) {
+    model_->GetRelativeWordTopicProbabilities(iterator.Word(),
+                                              &word_topic_probs[0]);
+    for (int k = 0; k < num_topics; ++k) {
+      new_topic_distribution[k] =
+          (document_distribution[k] + alpha_) * word_topic_probs[k];
+    }
+    iterator.SetTopic(GetAccumulativeSample(new_topic_distribution));
+  }
+}
+
+}  // namespace learning_lda
@@ -0,0 +1,120 @@
+// Copyright 2008 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef _OPENSOURCE_GLDA_QUANTIZED_MODEL_H__
+#define _OPENSOURCE_GLDA_QUANTIZED_MODEL_H__
+
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "common.h"
+#include "document.h"
+#include "model.h"
+
+namespace learning_lda {
+
+// LDAQuantizedModel is a compact read-only model for inference, which
+// stores every word-topic probability
+//   P(w|z=k) = (n_wk + beta) / (n_k + V * beta)
+// in 8 or 16 bits instead of an int64 count.  The probabilities are
+// quantized in the log domain relative to the largest one of their
+// word:
+//   P(w|z=k) ~= exp(row_log_max_[w] - code[w][k] * step_)
+// where step_ is the same for the whole model.  Since inference only
+// needs P(w|z) up to a factor per word, samplers work on the codes
+// directly through the table level(q) = exp(-q * step_).
+//
+// This class is thread-safe once constructed.
+class LDAQuantizedModel {
+ public:
+  // Quantizes model with the given number of bits, 8 or 16.  Log
+  // probability ratios within a word beyond the representable range are
+  // clamped to the smallest level.
+  LDAQuantizedModel(const LDAModel& model, double beta, int bits);
+
+  // Loads a model written by Save.  Returns a map from word string to
+  // index in word_index_map.
+  LDAQuantizedModel(std::istream& in, map<string, int>* word_index_map);
+
+  ~LDAQuantizedModel() {}
+
+  // Returns true if in holds a model written by Save.  Does not consume
+  // the stream.
+  static bool IsQuantizedModel(std::istream& in);
+
+  // Writes the model and its vocabulary word_index_map in a binary
+  // format.
+  void Save(const map<string, int>& word_index_map, std::ostream& out) const;
+
+  // Returns the level of code q, i.e., P(w|z) relative to the largest
+  // P(w|z) of the same word.
+  float level(int q) const { return levels_[q]; }
+
+  // Returns the code of P(word|z=topic).
+  int code(int word, int topic) const {
+    int64 index = static_cast<int64>(word) * num_topics_ + topic;
+    return bits_ == 8 ? codes8_[index] : codes16_[index];
+  }
+
+  // Writes the num_topics() values P(word|z=k) / max_k P(word|z=k) into
+  // probs.
+  void GetRelativeWordTopicProbabilities(int word, float* probs) const;
+
+  // Returns the dequantized P(word|z=topic).
+  double GetWordTopicProbability(int word, int topic) const;
+
+  int num_topics() const { return num_topics_; }
+  int num_words() const { return num_words_; }
+  int bits() const { return bits_; }
+
+  // Returns the number of bytes taken by the probabilities.
+  int64 memory_size() const;
+
+ private:
+  // Fills levels_ given bits_ and step_.
+  void ComputeLevels();
+
+  int num_topics_;
+  int num_words_;
+  int bits_;
+  double step_;
+  vector<float> row_log_max_;
+  vector<float> levels_;
+  // Only the one matching bits_ is used.
+  vector<unsigned char> codes8_;
+  vector<unsigned short> codes16_;
+};
+
+// LDAQuantizedSampler performs Gibbs sampling of query documents on an
+// LDAQuantizedModel, with the full conditional computed from the codes
+// as (n_dk + alpha) * level(code[w][k]).
+class LDAQuantizedSampler {
+ public:
+  LDAQuantizedSampler(double alpha, const LDAQuantizedModel* model);
+  ~LDAQuantizedSampler() {}
+
+  // Performs one round of Gibbs sampling on a document.  Updates
+  // document's topic assignments; the model is never changed.
+  void SampleNewTopicsForDocument(LDADocument* document) const;
+
+ private:
+  const double alpha_;
+  const LDAQuantizedModel* model_;
+};
+
+}  // namespace learning_lda
+
+#endif  // _OPENSOURCE_GLDA_QUANTIZED_MODEL_H__
@@ -25,7 +25,9 @@ LDASampler::LDASampler(double alpha,
                        double beta,
                        LDAModel* model,
                        LDAAccumulativeModel* accum_model)
-    : alpha_(alpha), beta_(beta), model_(model), accum_model_(accum_model) {
+    : alpha_(alpha), beta_(beta), model_(model), accum_model_(accum_model),
+      model_delta_(NULL),
+      vocabulary_size_(0) {
   CHECK_LT(0.0, alpha);
   CHECK_LT(0.0, beta);
   CHECK(model != NULL);
@@ -75,11 +77,33 @@ void LDASampler::SampleNewTopicsForDocument(LDADocument* document,
     if (update_model) {
       model_->ReassignTopic(
           iterator.Word(), iterator.Topic(), new_topic, 1);
+      if (model_delta_ != NULL && new_topic != iterator.Topic()) {
+        model_delta_->Add(iterator.Word(), iterator.Topic(), -1);
+        model_delta_->Add(iterator.Word(), new_topic, 1);
+      }
     }
     iterator.SetTopic(new_topic);
   }
 }
 
+void LDASampler::SampleNewTopicForWordOccurrence(LDADocument* document,
+                                                 int word, int index,
+                                                 bool update_model) {
+  int old_topic = document->Topic(index);
+  vector<double> new_topic_distribution;
+  GenerateTopicDistributionForWord(*document, word, old_topic, update_model,
+                                   &new_topic_distribution);
+  int new_topic = GetAccumulativeSample(new_topic_distribution);
+  if (update_model) {
+    model_->ReassignTopic(word, old_topic, new_topic, 1);
+    if (model_delta_ != NULL && new_topic != old_topic) {
+      model_delta_->Add(word, old_topic, -1);
+      model_delta_->Add(word, new_topic, 1);
+    }
+  }
+  document->SetTopic(index, new_topic);
+}
+
 void LDASampler::GenerateTopicDistributionForWord(
     const LDADocument& document,
     int word,
@@ -87,7 +111,7 @@ void LDASampler::GenerateTopicDistributionForWord(
     bool train_model,
     vector<double>* distribution) const {
   int num_topics = model_->num_topics();
-  int num_words = model_->num_words();
+  int num_words = vocabulary_size();
   distribution->clear();
   distribution->reserve(num_topics);
 
@@ -151,7 +175,7 @@ double LDASampler::LogLikelihood(LDADocument* document) const {
     for (int t = 0; t < num_topics; ++t) {
       prob_word_given_topic[t] =
           (word_topic_cooccurrences[t] + beta_) /
-          (global_topic_occurrences[t] + model_->num_words() * beta_);
+          (global_topic_occurrences[t] + vocabulary_size() * beta_);
     }
 
     // Compute P(w) = sum_z P(w|z)P(z|d)
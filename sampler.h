@@ -57,6 +57,13 @@ class LDASampler {
   void SampleNewTopicsForDocument(LDADocument* document,
                                   bool update_model);
 
+  // Samples a new topic for the index-th word occurrence of document
+  // (see LDADocument::Topic), whose word is word, as
+  // SampleNewTopicsForDocument does for every occurrence.  Used to sweep
+  // a corpus in word order.
+  void SampleNewTopicForWordOccurrence(LDADocument* document, int word,
+                                       int index, bool update_model);
+
   // The core of the Gibbs sampling process.  Compute the full conditional
   // posterior distribution of topic assignments to the indicated word.
   //
@@ -70,11 +77,29 @@ class LDASampler {
   // Computes the log likelihood of a document.
   double LogLikelihood(LDADocument* document) const;
 
+  // If model_delta is not NULL, every change made to model_ by
+  // SampleNewTopicsForDocument is also recorded into it.
+  void set_model_delta(LDAModelDelta* model_delta) {
+    model_delta_ = model_delta;
+  }
+
+  // The vocabulary size V in P(w|z) = (n_wz + beta) / (n_z + V * beta)
+  // is model_->num_words() unless set here, which is needed when model_
+  // only caches the rows of some words of a larger model.
+  void set_vocabulary_size(int vocabulary_size) {
+    vocabulary_size_ = vocabulary_size;
+  }
+  int vocabulary_size() const {
+    return vocabulary_size_ > 0 ? vocabulary_size_ : model_->num_words();
+  }
+
  private:
   const double alpha_;
   const double beta_;
   LDAModel* model_;
   LDAAccumulativeModel* accum_model_;
+  LDAModelDelta* model_delta_;
+  int vocabulary_size_;
 };
 
 
@@ -0,0 +1,130 @@
+// Copyright 2008 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+/*
+  A microbenchmark of the model synchronization modes of mpi_lda.  An
+  example running of this program:
+
+  mpiexec -n 8 ./sync_bench \
+  --num_topics 100 \
+  --num_words 100000 \
+  --delta_density 0.01 \
+  --total_iterations 5
+
+  Every process makes random changes to about delta_density of the
+  cells of a num_words x num_topics model, as moving word occurrences
+  between topics does, and the changes are synchronized by each of the
+  dense, sparse, compressed and reduce_scatter modes, total_iterations
+  times.  One tab-separated line is printed per mode: the number of
+  processes, the mode, the seconds per synchronization of the slowest
+  process, the bytes received per process and a checksum of the
+  resulting model, which must be the same for all modes.
+  sync_bench.sh runs it for 2 to 64 processes on the local machine.
+*/
+
+#include "mpi.h"
+
+#include <stdlib.h>
+
+#include <string>
+#include <vector>
+
+#include "common.h"
+#include "model.h"
+#include "parallel_model.h"
+#include "cmd_flags.h"
+
+int main(int argc, char** argv) {
+  using learning_lda::LDAModel;
+  using learning_lda::LDAModelDelta;
+  using learning_lda::ParallelLDAModel;
+  using learning_lda::LDACmdLineFlags;
+  int myid, pnum;
+  MPI_Init(&argc, &argv);
+  MPI_Comm_rank(MPI_COMM_WORLD, &myid);
+  MPI_Comm_size(MPI_COMM_WORLD, &pnum);
+
+  LDACmdLineFlags flags;
+  flags.ParseCmdFlags(argc, argv);
+  if (!flags.CheckSyncBenchmarkValidity()) {
+    MPI_Finalize();
+    return -1;
+  }
+  const int num_topics = flags.num_topics_;
+  const int num_words = flags.num_words_;
+
+  // The same changes are synchronized by every mode.
+  unsigned short random_state[3] = {
+    0x330E, static_cast<unsigned short>(myid & 0xFFFF),
+    static_cast<unsigned short>(myid >> 16)
+  };
+  const int64 num_moves = static_cast<int64>(
+      flags.delta_density_ * num_words * num_topics / 2);
+  vector<LDAModelDelta> deltas(flags.total_iterations_,
+                               LDAModelDelta(num_topics));
+  for (int i = 0; i < deltas.size(); ++i) {
+    for (int64 j = 0; j < num_moves; ++j) {
+      int word = static_cast<int>(erand48(random_state) * num_words);
+      int old_topic = static_cast<int>(erand48(random_state) * num_topics);
+      int new_topic = static_cast<int>(erand48(random_state) * num_topics);
+      deltas[i].Add(word, old_topic, -1);
+      deltas[i].Add(word, new_topic, 1);
+    }
+  }
+
+  if (myid == 0) {
+    std::cout << "processes\tmode\tseconds\tbytes\tchecksum" << std::endl;
+  }
+  const char* modes[] = { "dense", "sparse", "compressed", "reduce_scatter" };
+  for (int m = 0; m < sizeof(modes) / sizeof(modes[0]); ++m) {
+    const string mode = modes[m];
+    ParallelLDAModel model(num_topics, num_words, false);
+    double max_seconds = 0;
+    int64 bytes = 0;
+    for (int i = 0; i < deltas.size(); ++i) {
+      LDAModelDelta delta = deltas[i];
+      model.ApplyDelta(delta);
+      MPI_Barrier(MPI_COMM_WORLD);
+      double start = MPI_Wtime();
+      if (mode == "dense") {
+        model.DenseAllReduce(&delta);
+      } else if (mode == "sparse") {
+        model.SparseAllReduce(&delta);
+      } else if (mode == "compressed") {
+        model.CompressedAllReduce(&delta);
+      } else {
+        model.ReduceScatterAllReduce(&delta);
+      }
+      double seconds = MPI_Wtime() - start;
+      double slowest = 0;
+      MPI_Reduce(&seconds, &slowest, 1, MPI_DOUBLE, MPI_MAX, 0,
+                 MPI_COMM_WORLD);
+      max_seconds += slowest;
+      bytes += model.bytes_communicated();
+    }
+    int64 checksum = 0;
+    for (LDAModel::Iterator iter(&model); !iter.Done(); iter.Next()) {
+      for (int k = 0; k < num_topics; ++k) {
+        checksum += iter.Distribution()[k] *
+            (static_cast<int64>(iter.Word()) * num_topics + k + 1);
+      }
+    }
+    if (myid == 0) {
+      std::cout << pnum << "\t" << mode << "\t"
+                << max_seconds / deltas.size() << "\t"
+                << bytes / deltas.size() << "\t" << checksum << std::endl;
+    }
+  }
+  MPI_Finalize();
+  return 0;
+}
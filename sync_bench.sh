@@ -0,0 +1,11 @@
+#!/bin/sh
+# Runs sync_bench for 2 to 64 processes on the local machine, e.g.,
+#   ./sync_bench.sh --num_topics 100 --num_words 100000 --total_iterations 5
+# Extra arguments are passed to sync_bench.  Set MPIEXEC to change the
+# launcher, e.g., MPIEXEC="mpiexec --oversubscribe" when there are fewer
+# cores than processes.
+MPIEXEC=${MPIEXEC:-mpiexec}
+for processes in 2 4 8 16 32 64; do
+  $MPIEXEC -n $processes ./sync_bench "$@" | \
+    if [ $processes -eq 2 ]; then cat; else tail -n +2; fi
+done
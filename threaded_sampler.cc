@@ -0,0 +1,116 @@
+// Copyright 2008 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "threaded_sampler.h"
+
+#include <pthread.h>
+
+#include "corpus_partition.h"
+
+namespace learning_lda {
+
+ThreadedLDASampler::ThreadedLDASampler(double alpha, double beta,
+                                       LDAModel* model,
+                                       const LDACorpus& corpus,
+                                       int num_threads)
+    : threads_(num_threads) {
+  CHECK_LT(0, num_threads);
+  vector<int64> tokens;
+  for (LDACorpus::const_iterator iter = corpus.begin();
+       iter != corpus.end(); ++iter) {
+    tokens.push_back((*iter)->topics().wordtopics_size());
+  }
+  vector<int> partitions;
+  LongestProcessingTimePartition(tokens, num_threads, &partitions);
+  for (int t = 0; t < num_threads; ++t) {
+    threads_[t].num_tokens = 0;
+    threads_[t].cpu = -1;
+    threads_[t].documents_placed = true;
+    threads_[t].tokens_sampled = 0;
+    threads_[t].sampling_time = 0;
+  }
+  int i = 0;
+  for (LDACorpus::const_iterator iter = corpus.begin();
+       iter != corpus.end(); ++iter, ++i) {
+    threads_[partitions[i]].corpus.push_back(*iter);
+    threads_[partitions[i]].num_tokens += tokens[i];
+  }
+  for (int t = 0; t < num_threads; ++t) {
+    threads_[t].sampler = new LDASampler(alpha, beta, model, NULL);
+    threads_[t].delta = new LDAModelDelta(model->num_topics());
+    threads_[t].sampler->set_model_delta(threads_[t].delta);
+  }
+  if (num_threads > 1) {
+    model->set_concurrent(true);
+  }
+}
+
+ThreadedLDASampler::~ThreadedLDASampler() {
+  for (int t = 0; t < threads_.size(); ++t) {
+    delete threads_[t].sampler;
+    delete threads_[t].delta;
+  }
+}
+
+void ThreadedLDASampler::PinThreads(const NumaTopology* topology) {
+  for (int t = 0; t < threads_.size(); ++t) {
+    threads_[t].cpu = topology->ThreadCpu(t);
+    threads_[t].documents_placed = false;
+  }
+}
+
+void* ThreadedLDASampler::Run(void* arg) {
+  Thread* thread = static_cast<Thread*>(arg);
+  if (thread->cpu >= 0 && !PinThreadToCpu(thread->cpu)) {
+    LOG(WARNING) << "Failed to pin a sampling thread to CPU " << thread->cpu
+                 << "\n";
+  }
+  if (!thread->documents_placed) {
+    for (LDACorpus::iterator iter = thread->corpus.begin();
+         iter != thread->corpus.end(); ++iter) {
+      (*iter)->Reallocate();
+    }
+    thread->documents_placed = true;
+  }
+  double start = WallTime();
+  thread->sampler->DoIteration(&thread->corpus, true, false);
+  thread->sampling_time += WallTime() - start;
+  thread->tokens_sampled += thread->num_tokens;
+  return NULL;
+}
+
+void ThreadedLDASampler::DoIteration(LDAModelDelta* model_delta) {
+  // The calling thread samples the first part itself, unless the
+  // threads are pinned: it must keep its own CPU affinity.
+  const int first_spawned = threads_[0].cpu >= 0 ? 0 : 1;
+  vector<pthread_t> ids(threads_.size());
+  for (int t = first_spawned; t < threads_.size(); ++t) {
+    CHECK_EQ(0, pthread_create(&ids[t], NULL, Run, &threads_[t]));
+  }
+  if (first_spawned > 0) {
+    Run(&threads_[0]);
+  }
+  for (int t = first_spawned; t < threads_.size(); ++t) {
+    pthread_join(ids[t], NULL);
+  }
+  for (int t = 0; t < threads_.size(); ++t) {
+    LDAModelDelta* delta = threads_[t].delta;
+    if (model_delta != NULL) {
+      model_delta->Append(*delta);
+    }
+    delta->clear();
+  }
+}
+
+}  // namespace learning_lda
@@ -0,0 +1,81 @@
+// Copyright 2008 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef _OPENSOURCE_GLDA_THREADED_SAMPLER_H__
+#define _OPENSOURCE_GLDA_THREADED_SAMPLER_H__
+
+#include <vector>
+
+#include "common.h"
+#include "document.h"
+#include "model.h"
+#include "numa_placement.h"
+#include "sampler.h"
+
+namespace learning_lda {
+
+// ThreadedLDASampler performs Gibbs sampling iterations on a corpus with
+// several threads sharing one model, which is made concurrent (see
+// LDAModel::set_concurrent).  The documents are dealt to the threads by
+// the longest-processing-time rule so that every thread samples about
+// the same number of tokens.  Like AD-LDA across processes, a thread may
+// sample from counts that other threads are changing.
+class ThreadedLDASampler {
+ public:
+  // alpha and beta are the Gibbs sampling symmetric hyperparameters.
+  // corpus must outlive this object and model must not be changed by
+  // others during DoIteration.
+  ThreadedLDASampler(double alpha, double beta, LDAModel* model,
+                     const LDACorpus& corpus, int num_threads);
+  ~ThreadedLDASampler();
+
+  // Performs one round of Gibbs sampling on every document of the
+  // corpus, updating the model.  If model_delta is not NULL, the changes
+  // made by all threads are appended to it.
+  void DoIteration(LDAModelDelta* model_delta);
+
+  // Pins thread t to topology->ThreadCpu(t) from the next iteration on.
+  // Every thread then copies its documents into its own memory in its
+  // first iteration, so that they are placed on its NUMA node.  The
+  // calling thread is not pinned; it no longer samples itself.
+  void PinThreads(const NumaTopology* topology);
+
+  int num_threads() const { return threads_.size(); }
+
+  // Returns the number of word occurrences sampled by thread t and the
+  // time it took, over all iterations so far.
+  int64 tokens_sampled(int t) const { return threads_[t].tokens_sampled; }
+  double sampling_time(int t) const { return threads_[t].sampling_time; }
+
+ private:
+  struct Thread {
+    LDASampler* sampler;
+    LDAModelDelta* delta;
+    LDACorpus corpus;
+    int64 num_tokens;
+    // The CPU to pin to, or -1.
+    int cpu;
+    bool documents_placed;
+    int64 tokens_sampled;
+    double sampling_time;
+  };
+
+  static void* Run(void* arg);
+
+  vector<Thread> threads_;
+};
+
+}  // namespace learning_lda
+
+#endif  // _OPENSOURCE_GLDA_THREADED_SAMPLER_H__
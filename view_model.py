@@ -8,6 +8,8 @@ map = []
 sum = []
 word_sum = {}
 for line in open(sys.argv[1]):
+  if line.startswith("#"):
+    continue
   sep = line.split("\t")
   word = sep[0]
   sep = sep[1].split()
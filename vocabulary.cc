@@ -0,0 +1,186 @@
+// Copyright 2008 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "vocabulary.h"
+
+#include <algorithm>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <utility>
+#include <vector>
+
+namespace learning_lda {
+
+namespace {
+
+const char kHashBucketPrefix[] = "__bucket_";
+const char kHeader[] = "#vocabulary_filter";
+const char kKeptWordHeader[] = "#kept_word ";
+
+struct WordStatistics {
+  int64 count;
+  int64 num_documents;
+  // The last document counted in num_documents.
+  int64 last_document;
+};
+
+// Orders words by decreasing count, and by the word for equal counts.
+bool MoreFrequent(const std::pair<int64, string>& a,
+                  const std::pair<int64, string>& b) {
+  return a.first > b.first || (a.first == b.first && a.second < b.second);
+}
+
+}  // namespace
+
+VocabularyFilter::VocabularyFilter()
+    : num_hash_buckets_(0), pruned_(false), num_pruned_words_(0) {
+}
+
+VocabularyFilter::VocabularyFilter(const LDACmdLineFlags& flags)
+    : num_hash_buckets_(flags.num_hash_buckets_), pruned_(false),
+      num_pruned_words_(0) {
+  if (flags.min_word_count_ > 0 || flags.max_doc_frequency_ < 1 ||
+      flags.max_vocab_size_ > 0) {
+    Prune(flags.training_data_file_, flags.min_word_count_,
+          flags.max_doc_frequency_, flags.max_vocab_size_);
+  }
+}
+
+void VocabularyFilter::Prune(const string& corpus_file,
+                             int64 min_word_count,
+                             double max_doc_frequency,
+                             int max_vocab_size) {
+  map<string, WordStatistics> statistics;
+  std::ifstream fin(corpus_file.c_str());
+  string line;
+  int64 num_documents = 0;
+  while (getline(fin, line)) {
+    if (line.size() > 0 &&      // Skip empty lines.
+        line[0] != '\r' &&      // Skip empty lines.
+        line[0] != '\n' &&      // Skip empty lines.
+        line[0] != '#') {       // Skip comment lines.
+      std::istringstream ss(line);
+      string word;
+      int count;
+      while (ss >> word >> count) {
+        map<string, WordStatistics>::iterator iter = statistics.find(word);
+        if (iter == statistics.end()) {
+          WordStatistics zero = { 0, 0, -1 };
+          iter = statistics.insert(std::make_pair(word, zero)).first;
+        }
+        iter->second.count += count;
+        if (iter->second.last_document != num_documents) {
+          iter->second.last_document = num_documents;
+          ++iter->second.num_documents;
+        }
+      }
+      ++num_documents;
+    }
+  }
+
+  vector<std::pair<int64, string> > candidates;
+  for (map<string, WordStatistics>::const_iterator iter = statistics.begin();
+       iter != statistics.end(); ++iter) {
+    if (iter->second.count >= min_word_count &&
+        iter->second.num_documents <= max_doc_frequency * num_documents) {
+      candidates.push_back(std::make_pair(iter->second.count, iter->first));
+    }
+  }
+  if (max_vocab_size > 0 && candidates.size() > max_vocab_size) {
+    std::partial_sort(candidates.begin(), candidates.begin() + max_vocab_size,
+                      candidates.end(), MoreFrequent);
+    candidates.resize(max_vocab_size);
+  }
+  kept_words_.clear();
+  for (int i = 0; i < candidates.size(); ++i) {
+    kept_words_.insert(candidates[i].second);
+  }
+  pruned_ = true;
+  num_pruned_words_ = statistics.size() - kept_words_.size();
+}
+
+bool VocabularyFilter::Map(const string& word, string* model_word) const {
+  if (pruned_ && kept_words_.find(word) == kept_words_.end()) {
+    return false;
+  }
+  if (num_hash_buckets_ > 0) {
+    std::ostringstream bucket;
+    bucket << kHashBucketPrefix << HashWord(word) % num_hash_buckets_;
+    *model_word = bucket.str();
+  } else {
+    *model_word = word;
+  }
+  return true;
+}
+
+void VocabularyFilter::AppendAsString(std::ostream& out) const {
+  if (!active()) {
+    return;
+  }
+  // Hashed models do not tell the kept words.
+  const bool persist_kept_words = pruned_ && num_hash_buckets_ > 0;
+  out << kHeader << " num_hash_buckets " << num_hash_buckets_
+      << " pruned_words " << num_pruned_words_;
+  if (persist_kept_words) {
+    out << " kept_words " << kept_words_.size();
+  }
+  out << "\n";
+  if (persist_kept_words) {
+    for (std::set<string>::const_iterator iter = kept_words_.begin();
+         iter != kept_words_.end(); ++iter) {
+      out << kKeptWordHeader << *iter << "\n";
+    }
+  }
+}
+
+void VocabularyFilter::ReadHeader(std::istream& in) {
+  // Only the header is compared, since binary models have no lines.
+  std::streampos position = in.tellg();
+  string header(strlen(kHeader), ' ');
+  in.read(&header[0], header.size());
+  if (in.gcount() == header.size() && header == kHeader) {
+    string line;
+    getline(in, line);
+    std::istringstream ss(line);
+    string name;
+    int64 value;
+    int64 num_kept_words = -1;
+    while (ss >> name >> value) {
+      if (name == "num_hash_buckets") {
+        num_hash_buckets_ = value;
+      } else if (name == "pruned_words") {
+        num_pruned_words_ = value;
+      } else if (name == "kept_words") {
+        num_kept_words = value;
+      }
+    }
+    if (num_kept_words >= 0) {
+      pruned_ = true;
+      kept_words_.clear();
+      const string kept_word_header = kKeptWordHeader;
+      for (int64 i = 0; i < num_kept_words; ++i) {
+        CHECK(static_cast<bool>(getline(in, line)));
+        CHECK_EQ(0, line.compare(0, kept_word_header.size(),
+                                 kept_word_header));
+        kept_words_.insert(line.substr(kept_word_header.size()));
+      }
+    }
+    return;
+  }
+  in.clear();
+  in.seekg(position);
+}
+
+}  // namespace learning_lda
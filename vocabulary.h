@@ -0,0 +1,85 @@
+// Copyright 2008 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef _OPENSOURCE_GLDA_VOCABULARY_H__
+#define _OPENSOURCE_GLDA_VOCABULARY_H__
+
+#include <iostream>
+#include <set>
+#include <string>
+
+#include "common.h"
+#include "cmd_flags.h"
+
+namespace learning_lda {
+
+// VocabularyFilter maps the words of documents to the words of a model
+// at load time, to bound the model size V x K.  Words are pruned by
+// their statistics in the training data, and the remaining words are
+// optionally hashed into a fixed number of buckets (the hashing trick),
+// which the model names "__bucket_<b>".
+//
+// The filter is persisted as comment lines at the top of the model file,
+// which LDAModel skips, so that infer maps the words of its documents the
+// same way.  If words are both pruned and hashed, the kept words are
+// persisted as well, one "#kept_word <word>" line each; otherwise the
+// words of the model are the kept words.
+class VocabularyFilter {
+ public:
+  // Creates a filter that keeps every word as it is.
+  VocabularyFilter();
+
+  // Creates the filter given by the min_word_count, max_doc_frequency,
+  // max_vocab_size and num_hash_buckets flags.  If any of the first
+  // three is given, the words of training_data_file are counted in a
+  // pre-pass.
+  explicit VocabularyFilter(const LDACmdLineFlags& flags);
+
+  ~VocabularyFilter() {}
+
+  // Returns false if word is pruned.  Otherwise sets model_word to the
+  // word of the model for word.
+  bool Map(const string& word, string* model_word) const;
+
+  // Returns true if the filter changes any word.
+  bool active() const { return pruned_ || num_hash_buckets_ > 0; }
+
+  // Writes the filter as comment lines if it is active.
+  void AppendAsString(std::ostream& out) const;
+
+  // Reads a filter written by AppendAsString at the current position of
+  // in.  If there is none, in is not consumed and the filter is left
+  // unchanged.
+  void ReadHeader(std::istream& in);
+
+  int num_hash_buckets() const { return num_hash_buckets_; }
+  int num_kept_words() const { return kept_words_.size(); }
+  int num_pruned_words() const { return num_pruned_words_; }
+
+ private:
+  // Counts the words of corpus_file and keeps those that occur at least
+  // min_word_count times in at most max_doc_frequency of the documents,
+  // and only the max_vocab_size most frequent of them if it is positive.
+  void Prune(const string& corpus_file, int64 min_word_count,
+             double max_doc_frequency, int max_vocab_size);
+
+  int num_hash_buckets_;
+  bool pruned_;
+  std::set<string> kept_words_;
+  int num_pruned_words_;
+};
+
+}  // namespace learning_lda
+
+#endif  // _OPENSOURCE_GLDA_VOCABULARY_H__